@@ -0,0 +1,87 @@
+// Measures what inserting emails into storage costs, with the move-only insert path and with the three deep
+// copies per email the path used to make (into the view's queue, out of it, and into storage).
+//
+// Copies are counted as heap allocations, which every deep copy of an Email makes for its headers, body and
+// attributes. Usage: EmailInsertBenchmark [emails] (default 100000).
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include "AttributeBagValueInterface.hpp"
+#include "Email.hpp"
+#include "EmailBody.hpp"
+#include "EmailListView.hpp"
+#include "EmailStorage.hpp"
+
+namespace {
+    std::atomic<size_t> allocations = 0;
+}
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+    std::vector<Email> makeEmails(size_t count) {
+        std::vector<Email> emails;
+        emails.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            Email& email = emails.emplace_back();
+            email.setHeader("From", "sender" + std::to_string(i) + "@example.com");
+            email.setHeader("Subject", "Benchmark email number " + std::to_string(i));
+            email.setHeader("Date", "Mon, 1 Jan 2024 00:00:00 +0000");
+            email.setBody(std::make_unique<StandardEmailBody>(std::string(2048, 'x')));
+            email.insertAttribute("File identifier", std::make_unique<AttributeBagString>("email" + std::to_string(i) + ".eml"));
+        }
+        return emails;
+    }
+
+    template <typename Insert>
+    void run(const char* name, size_t count, Insert insert) {
+        std::vector<Email> emails = makeEmails(count);
+        EmailStorage storage;
+        EmailListView view = storage.getFullView();
+
+        size_t allocationsBefore = allocations.load();
+        auto started = std::chrono::steady_clock::now();
+        for (Email& email : emails) {
+            insert(view, email);
+        }
+        view.commitInserts();
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started);
+        size_t made = allocations.load() - allocationsBefore;
+
+        std::printf("%-8s %8zu emails %10.1f ms %8.2f allocations per email\n", name, count, elapsed.count(),
+                    static_cast<double>(made) / static_cast<double>(count));
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+
+    // Only the queue and storage growing allocate, amortised to well under one allocation per email.
+    run("move", count, [](EmailListView& view, Email& email) {
+        view.insertEmail(std::move(email));
+    });
+
+    run("3 copies", count, [](EmailListView& view, Email& email) {
+        Email queued(email);
+        Email dequeued(queued);
+        view.insertEmail(Email(dequeued));
+    });
+    return 0;
+}
@@ -5,6 +5,7 @@
 #include <functional>
 #include <unordered_map>
 
+#include "BlobStore.hpp"
 #include "Logger.hpp"
 
 
@@ -187,3 +188,32 @@ private:
     };
     static inline Register reg;
 };
+
+// Holds a handle into the BlobStore, so copies and clones share the underlying bytes.
+class AttributeBagBlob final : public AttributeBagValueInterface {
+public:
+    explicit AttributeBagBlob(BlobHandle val) : value(std::move(val)) {}
+    std::string toString() override {
+        return std::string(value->view());
+    }
+    std::string serializeToString() override {
+        return "AttributeBagBlob:" + toString();
+    }
+    AttributeBagValueInterface* clone() override {
+        return new AttributeBagBlob(*this);
+    }
+    const BlobHandle& getBlob() const {
+        return value;
+    }
+    static std::unique_ptr<AttributeBagValueInterface> createFromValue(const std::string& value) {
+        return std::make_unique<AttributeBagBlob>(BlobStore::getInstance()->intern(value));
+    }
+private:
+    BlobHandle value;
+    struct Register {
+        Register() {
+            AttributeBagRegistry::getInstance().registerType("AttributeBagBlob", createFromValue);
+        }
+    };
+    static inline Register reg;
+};
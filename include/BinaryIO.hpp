@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+
+/**
+ * @brief Minimal helpers for the native-endian binary files Inlook writes for itself (result cache,
+ * checkpoints). Strings are written as a 32-bit length followed by their bytes.
+ */
+namespace BinaryIO {
+    template <typename T>
+    void writeValue(std::ostream& out, const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    bool readValue(std::istream& in, T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+
+    inline void writeString(std::ostream& out, const std::string& value) {
+        writeValue(out, static_cast<uint32_t>(value.size()));
+        out.write(value.data(), static_cast<std::streamsize>(value.size()));
+    }
+
+    inline bool readString(std::istream& in, std::string& value) {
+        uint32_t length;
+        if (!readValue(in, length)) return false;
+        value.resize(length);
+        return static_cast<bool>(in.read(value.data(), length));
+    }
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * @brief An immutable run of bytes, shared between every email that references it.
+ *
+ * A Blob is either heap-backed (owns a std::string) or file-backed (owns a read-only
+ * mmap of a file). Either way the contents never change once created, so handles can be
+ * copied freely between threads and emails.
+ */
+class Blob {
+public:
+    /**
+     * @brief Creates a heap-backed blob that takes ownership of the given bytes.
+     * @param bytes The contents of the blob.
+     */
+    explicit Blob(std::string bytes);
+
+    /**
+     * @brief Creates a file-backed blob over an existing read-only mapping.
+     *
+     * The blob takes ownership of the mapping and unmaps it on destruction.
+     *
+     * @param mapping Start of the mapped region.
+     * @param length Length of the mapped region in bytes.
+     */
+    Blob(const char* mapping, size_t length);
+
+    /**
+     * @brief Creates a file-backed blob over part of a mapping shared with other blobs.
+     *
+     * The hash is supplied by the caller (e.g. stored alongside the bytes), so creating the blob
+     * does not page the bytes in.
+     *
+     * @param bytes The blob's bytes, inside the mapping.
+     * @param hash The content hash of the bytes, as hash() would compute it.
+     * @param mappingOwner Keeps the mapping alive, and unmaps it once the last blob using it is gone.
+     */
+    Blob(std::string_view bytes, size_t hash, std::shared_ptr<const void> mappingOwner);
+
+    ~Blob();
+
+    Blob(const Blob&) = delete;
+    Blob& operator=(const Blob&) = delete;
+
+    /**
+     * @brief Retrieves the contents of the blob.
+     * @return A view over the blob's bytes, valid for the lifetime of the blob.
+     */
+    std::string_view view() const;
+
+    /**
+     * @brief Retrieves the size of the blob.
+     * @return The number of bytes in the blob.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Retrieves the content hash of the blob.
+     *
+     * Equal to the StableHash of the same bytes as a string, so it can stand in for hashes computed
+     * over a copied string, and be persisted.
+     *
+     * @return The content hash.
+     */
+    size_t hash() const;
+
+    /**
+     * @brief Checks whether the blob is backed by a file mapping rather than the heap.
+     * @return True if the blob is file-backed.
+     */
+    bool isMapped() const;
+
+private:
+    std::string bytes_;               ///< Owned contents for heap-backed blobs.
+    const char* mapping_ = nullptr;   ///< Start of the mapping for file-backed blobs.
+    size_t mappingLength_ = 0;        ///< Length of the mapping for file-backed blobs.
+    size_t hash_ = 0;
+    std::shared_ptr<const void> mappingOwner_; ///< Set when the mapping is shared, and then not unmapped here.
+};
+
+using BlobHandle = std::shared_ptr<const Blob>;
+
+/**
+ * @brief Singleton, content-addressed store for large immutable byte runs (e.g. raw email files).
+ *
+ * Blobs are reference counted through BlobHandle: the store only keeps weak references, so a blob
+ * is released as soon as the last email pointing at it is destroyed. Interning identical bytes twice
+ * returns the same handle, so duplicated input files only occupy memory once.
+ */
+class BlobStore {
+public:
+    /**
+     * @brief Gets the singleton instance of BlobStore.
+     * @return Pointer to the singleton instance.
+     */
+    static BlobStore* getInstance();
+
+    /**
+     * @brief Interns a run of bytes.
+     *
+     * @param bytes The bytes to store. Moved into the store if they are not already present.
+     * @return A handle to the (possibly pre-existing) blob with the same contents.
+     */
+    BlobHandle intern(std::string bytes);
+
+    /**
+     * @brief Interns the contents of a file.
+     *
+     * @param path The file to read.
+     * @param mapFile If true, the blob is backed by a read-only mmap of the file instead of a heap copy.
+     * @return A handle to the (possibly pre-existing) blob with the file's contents.
+     * @throws std::runtime_error if the file cannot be opened.
+     */
+    BlobHandle internFile(const std::filesystem::path& path, bool mapFile = false);
+
+    /**
+     * @brief Interns bytes that live inside a shared file mapping, without copying them.
+     *
+     * @param bytes The bytes, inside the mapping.
+     * @param hash The content hash of the bytes.
+     * @param mappingOwner Keeps the mapping alive.
+     * @return A handle to the (possibly pre-existing) blob with the same contents.
+     */
+    BlobHandle internMapped(std::string_view bytes, size_t hash, std::shared_ptr<const void> mappingOwner);
+
+    /**
+     * @brief Drops bookkeeping for blobs that are no longer referenced by any handle.
+     */
+    void purgeExpired();
+
+    /**
+     * @brief Retrieves the number of live blobs in the store.
+     * @return The number of blobs with at least one handle.
+     */
+    size_t getBlobCount();
+
+    /**
+     * @brief Retrieves the number of bytes held by live blobs.
+     * @return The total size of all live blobs, heap and file-backed.
+     */
+    size_t getStoredBytes();
+
+private:
+    BlobStore() = default;
+    BlobStore(const BlobStore&) = delete;
+    BlobStore& operator=(const BlobStore&) = delete;
+
+    BlobHandle insertOrFind(std::unique_ptr<Blob> blob);
+
+    std::mutex mtx_;
+    std::unordered_multimap<size_t, std::weak_ptr<const Blob>> blobs_; ///< Content hash to live blobs.
+    size_t internsSincePurge_ = 0;
+};
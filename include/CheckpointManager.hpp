@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <string>
+#include "nlohmann/json.hpp"
+
+class EmailStorage;
+
+/**
+ * @brief Periodically persists workflow progress, so a restarted workflow resumes where it stopped.
+ *
+ * A checkpoint is an EmailSegmentFile of all of EmailStorage plus a small progress file recording how many
+ * of an executor's plugins had completed, and each plugin's state. The emails are captured at a plugin
+ * boundary, while nothing is modifying them, as shallow copies that share bodies and attribute values, then
+ * streamed to disk on a background thread so the next plugin can start straight away. Files are written
+ * then renamed, and the progress file is only written once the snapshot it names is, so a crash while
+ * writing leaves the previous checkpoint intact. Resuming maps the snapshot, so restored bodies are paged
+ * in as they are read.
+ */
+class CheckpointManager {
+public:
+    /**
+     * @brief Gets the process-wide manager.
+     *
+     * Checkpoints go to "checkpoint_dir" from the global config, at most once every
+     * "checkpoint_interval_seconds".
+     *
+     * @return Pointer to the shared manager.
+     */
+    static CheckpointManager* getInstance();
+
+    CheckpointManager(std::filesystem::path directory, std::chrono::seconds interval);
+
+    /**
+     * @brief Waits for a checkpoint still being written.
+     */
+    ~CheckpointManager();
+
+    CheckpointManager(const CheckpointManager&) = delete;
+    CheckpointManager& operator=(const CheckpointManager&) = delete;
+
+    /**
+     * @brief Derives the name checkpoints of a workflow are stored under, from its config.
+     * @param config The executor's config.
+     * @return A key that changes whenever the config does, and only then, across builds.
+     */
+    static std::string makeWorkflowKey(const nlohmann::json& config);
+
+    /**
+     * @brief Restores the last checkpoint of a workflow into storage.
+     *
+     * Only restores into empty storage, as restored emails would otherwise be duplicated.
+     *
+     * @param workflowKey The workflow, from makeWorkflowKey().
+     * @param storage The storage to restore into.
+     * @param pluginStates Receives the state of each plugin, by instance ID, recorded with the checkpoint.
+     * @return The number of plugins that had completed, 0 if there was nothing to resume.
+     */
+    size_t resume(const std::string& workflowKey, EmailStorage& storage, nlohmann::json& pluginStates);
+
+    /**
+     * @brief Records that the first completed plugins of a workflow have finished.
+     *
+     * Writes a checkpoint if the interval has passed since the last one.
+     *
+     * @param workflowKey The workflow, from makeWorkflowKey().
+     * @param completed The number of plugins completed, in configured order.
+     * @param storage The storage to snapshot.
+     * @param pluginStates The state of each plugin, by instance ID, recorded alongside.
+     */
+    void pluginsCompleted(const std::string& workflowKey, size_t completed, EmailStorage& storage, const nlohmann::json& pluginStates);
+
+    /**
+     * @brief Removes a workflow's checkpoint once it has run to completion.
+     * @param workflowKey The workflow, from makeWorkflowKey().
+     */
+    void finish(const std::string& workflowKey);
+
+private:
+    void waitForWrite();
+    void removeSnapshots(const std::string& workflowKey, const std::string& keep) const;
+
+    std::filesystem::path directory_;
+    std::chrono::seconds interval_;
+    std::mutex mtx_;
+    std::future<void> pendingWrite_;
+    std::chrono::steady_clock::time_point lastCheckpoint_{};
+};
@@ -3,9 +3,11 @@
 #include <any>
 #include <string>
 #include <map>
+#include <set>
 #include <utility>
 #include <vector>
 #include <memory>
+#include <shared_mutex>
 #include <unordered_map>
 #include <functional>
 #include <sstream>
@@ -56,9 +58,9 @@ public:
     /**
      * @brief Move constructor.
      *
-     * Defaulted move constructor for the Email class.
+     * Moves every member except the mutex, which each Email owns.
      */
-    Email(Email&& other) noexcept = default;
+    Email(Email&& other) noexcept;
 
     /**
      * @brief Move assignment operator.
@@ -70,6 +72,16 @@ public:
      */
     Email& operator=(Email&& other) noexcept;
 
+    /**
+     * @brief Copies the email, sharing its body and attribute values instead of cloning them.
+     *
+     * Bodies and attribute values are replaced rather than modified once set, so the copy keeps the
+     * content the email had when it was taken, at the cost of copying its headers.
+     *
+     * @return The shallow copy.
+     */
+    Email shallowCopy() const;
+
     /**
      * @brief Jsonify an entire email.
      *
@@ -120,9 +132,9 @@ public:
     /**
      * @brief Retrieves the email body.
      *
-     * @return A pointer to the EmailBody of the email.
+     * @return A handle to the EmailBody of the email, which stays valid if the body is replaced meanwhile.
      */
-    EmailBody* getBody() const;
+    std::shared_ptr<EmailBody> getBody() const;
 
     /**
      * @brief Retrieves the list of attribute keys.
@@ -134,18 +146,18 @@ public:
     /**
      * @brief Retrieves all attribute values.
      *
-     * @return A vector of pointers to AttributeBagValueInterface.
+     * @return Handles to the values, which stay valid if an attribute is replaced meanwhile.
      */
-    std::vector<AttributeBagValueInterface*> getAttributeValues() const;
+    std::vector<std::shared_ptr<AttributeBagValueInterface>> getAttributeValues() const;
 
     /**
      * @brief Retrieves the value of a specific attribute.
      *
      * @param key The key of the attribute to retrieve.
-     * @return The value of the attribute as a pointer to AttributeBagValueInterface.
+     * @return A handle to the value, which stays valid if the attribute is replaced meanwhile.
      * @throws std::out_of_range if the key is not found.
      */
-    AttributeBagValueInterface* getAttributeValue(const std::string& key) const;
+    std::shared_ptr<AttributeBagValueInterface> getAttributeValue(const std::string& key) const;
 
     /**
      * @brief Inserts an attribute into the attribute bag.
@@ -157,6 +169,24 @@ public:
      */
     void insertAttribute(const std::string& key, std::unique_ptr<AttributeBagValueInterface> attribute);
 
+    /**
+     * @brief Retrieves the keys of attributes inserted or replaced since the email was last saved to a destination.
+     *
+     * Lets savers write only what changed since the email was last loaded from or written to that destination.
+     * Each destination is tracked separately, so one saver does not hide changes from another.
+     *
+     * @param destination Identifies the storage, such as a database and dataset.
+     * @return The keys of the dirty attributes, or every key if the email was never saved to the destination.
+     */
+    std::vector<std::string> getDirtyAttributeKeys(const std::string& destination) const;
+
+    /**
+     * @brief Marks every attribute as clean for a destination, once the email matches what is stored there.
+     *
+     * @param destination Identifies the storage, as passed to getDirtyAttributeKeys().
+     */
+    void markAttributesSaved(const std::string& destination);
+
     /**
      * @brief Sets the MIME multipart status of the email.
      *
@@ -186,6 +216,13 @@ public:
      */
     size_t getUniqueHash() const;
 
+    /**
+     * @brief Restores a unique hash computed earlier, for emails reloaded from storage.
+     *
+     * @param hash The hash value generateUniqueHash() produced for this email.
+     */
+    void setUniqueHash(size_t hash);
+
     /**
      * @brief Checks if two Emails are the same based on their hash values.
      *
@@ -194,9 +231,18 @@ public:
     bool operator==(const Email& other) const;
 
 private:
+    // Guards header, body and attribute_bag, so readers such as the web UI can serialise an email while a
+    // plugin adds attributes to it. Values are shared, so a handle taken under the lock outlives a replace.
+    mutable std::shared_mutex mtx_;
     std::map<std::string, std::string> header;
-    std::unique_ptr<EmailBody> body;
-    std::pmr::unordered_map<std::string, std::unique_ptr<AttributeBagValueInterface>> attribute_bag;
+    std::shared_ptr<EmailBody> body;
+    std::pmr::unordered_map<std::string, std::shared_ptr<AttributeBagValueInterface>> attribute_bag;
+    // Dirty tracking, guarded by mtx_. Each insert bumps attributeRevision and stamps its key in changedAttributes.
+    // A destination has saved every attribute stamped at or below its savedRevisions entry, so stamps at or
+    // below the lowest entry are dropped.
+    uint64_t attributeRevision = 0;
+    std::map<std::string, uint64_t> changedAttributes;
+    std::map<std::string, uint64_t> savedRevisions;
     bool isMIMEMultipart;
     size_t uniqueHash;
 };
\ No newline at end of file
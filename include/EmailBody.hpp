@@ -1,5 +1,7 @@
 #pragma once
+#include <memory>
 #include <string>
+#include <string_view>
 #include <sstream>
 
 class EmailBody {
@@ -11,11 +13,19 @@ public:
 class StandardEmailBody final : public EmailBody {
 private:
     std::string content;
+    std::string_view mappedContent;          // Set instead of content for bodies left in a mapped snapshot file.
+    std::shared_ptr<const void> mappingOwner; // Keeps that mapping alive.
 public:
     StandardEmailBody() = default;
     explicit StandardEmailBody(const std::string& content) : content(content) {}
-     std::string getAllBodyData() {return content;}
-    void setContent(const std::string& newContent) {content = newContent;}
+    // A body read in place from a mapped file, only paged in once it is read.
+    StandardEmailBody(std::string_view mapped, std::shared_ptr<const void> owner) : mappedContent(mapped), mappingOwner(std::move(owner)) {}
+     std::string getAllBodyData() {return mappingOwner ? std::string(mappedContent) : content;}
+    void setContent(const std::string& newContent) {
+        content = newContent;
+        mappedContent = {};
+        mappingOwner.reset();
+    }
 };
 
 
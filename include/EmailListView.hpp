@@ -2,38 +2,216 @@
 
 #include <vector>
 #include <iterator>
+#include <map>
 #include <shared_mutex>
 #include "Email.hpp"
+#include "EmailStorage.hpp"
+#include "SegmentedVector.hpp"
 
-class EmailStorage;
+// Rows picked out of a view, in iteration order, as built by EmailListView::appendRow(). Runs of adjacent rows
+// are kept as ranges. Once that costs more than a bitmap would, the ranges become spans of rows with one bit
+// per spanned row in mask, so a sparse selection over a large corpus no longer costs a range per row.
+struct EmailRowSelection {
+    std::vector<EmailRowRange> ranges;
+    std::vector<uint64_t> mask; // Bit i set if row i of ranges, counted in order, is selected. Empty when all are.
+    size_t maskBits = 0;
+};
 
 class EmailListView {
+public:
+    // Forward iterator that walks the view's row ranges, stepping from one shard to the next and
+    // skipping rows that have been removed or left out of the view's selection mask.
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Email;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Email*;
+        using reference = Email&;
+
+        Iterator() = default;
+        Iterator(EmailStorage* storage, const std::vector<EmailRowRange>* ranges, const std::vector<uint64_t>* mask,
+                 size_t rangeIndex);
+
+        Email& operator*() const { return shard_->emails_[row_]; }
+        Email* operator->() const { return &shard_->emails_[row_]; }
+
+        Iterator& operator++() {
+            do {
+                if (++row_ == rangeEnd_) {
+                    nextRange();
+                    enterRange();
+                    return *this;
+                }
+            } while (shard_->isRemoved(row_) || !isSelected());
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return rangeIndex_ == other.rangeIndex_ && row_ == other.row_;
+        }
+
+        // Position of the current email within storage.
+        size_t shard() const { return (*ranges_)[rangeIndex_].shard; }
+        size_t row() const { return row_; }
+
+    private:
+        // Moves to the first live row of the next range with one, starting at rangeIndex_.
+        void enterRange();
+
+        void nextRange() {
+            const EmailRowRange& range = (*ranges_)[rangeIndex_++];
+            rangeOffset_ += range.end - range.begin;
+        }
+
+        bool isSelected() const {
+            if (!mask_) return true;
+            size_t offset = rangeOffset_ + (row_ - (*ranges_)[rangeIndex_].begin);
+            return ((*mask_)[offset / 64] >> (offset % 64)) & 1;
+        }
+
+        EmailStorage* storage_ = nullptr;
+        const std::vector<EmailRowRange>* ranges_ = nullptr;
+        const std::vector<uint64_t>* mask_ = nullptr; // Null when every row of the ranges is selected.
+        EmailStorage::Shard* shard_ = nullptr; // Cached so dereferencing skips the shard lookup.
+        size_t rangeIndex_ = 0;
+        size_t row_ = 0;
+        size_t rangeEnd_ = 0;
+        size_t rangeOffset_ = 0; // Row offset, within the view, at which the current range starts.
+    };
+
 private:
     EmailStorage* storage_;
-    size_t startIndex_;
-    size_t endIndex_;
-    std::queue<Email> insertQueue_;
+    std::vector<EmailRowRange> ranges_;
+    std::vector<uint64_t> mask_; // Selected rows of ranges_, as in EmailRowSelection. Empty when all are.
+    bool fullView_; // Full views pick up everything committed to storage, partial views only their own inserts.
+    bool narrowed_ = false; // Set by narrowTo(), so whoever handed out this view can carry the narrowing back.
+    std::vector<Email> insertQueue_;
 
 public:
-    EmailListView(EmailStorage *storage, size_t startIndex, size_t endIndex);
+    EmailListView(EmailStorage *storage, std::vector<EmailRowRange> ranges, bool fullView,
+                  std::vector<uint64_t> mask = {});
 
     ~EmailListView();
 
-    std::vector<Email>::iterator begin();
-    std::vector<Email>::iterator end();
+    // Views are move-only, so queued inserts are never cloned.
+    EmailListView(EmailListView&& other) noexcept;
+    EmailListView(const EmailListView&) = delete;
+    EmailListView& operator=(const EmailListView&) = delete;
+
+    Iterator begin();
+    Iterator end();
 
     // Splits this view into sub-views
     std::vector<EmailListView> split(int numParts);
 
-    // Queue an Email for insertion
-    void insertEmail(const Email& email);
+    // Get the number of rows this view covers, removed and unselected rows included
+    size_t getRowCount() const;
+
+    // Get the row offset, within this view, at which each of its ranges starts
+    std::vector<size_t> getRangeOffsets() const;
+
+    // Builds a partial view over rows [offset, offset + count) of this view, removed rows included.
+    // The slice keeps this view's selection mask for those rows.
+    // rangeOffsets must come from getRangeOffsets(), so repeated slicing does not rescan every range.
+    EmailListView slice(size_t offset, size_t count, const std::vector<size_t>& rangeOffsets) const;
+
+    // Queue an Email for insertion, taking ownership of it
+    void insertEmail(Email&& email);
+
+    // Construct an Email in place at the back of the insert queue
+    template <typename... Args>
+    Email& emplaceEmail(Args&&... args) {
+        return insertQueue_.emplace_back(std::forward<Args>(args)...);
+    }
+
+    // Removes the Email at the iterator's position in O(1). It stays in storage until compaction.
+    bool removeEmail(const Iterator& position);
+
+    // Removes every Email in this view matching the predicate in one pass, returns how many were removed
+    template <typename Predicate>
+    size_t removeWhere(Predicate predicate) {
+        size_t removed = 0;
+        for (auto it = begin(); it != end(); ++it) {
+            if (predicate(std::as_const(*it)) && removeEmail(it)) {
+                ++removed;
+            }
+        }
+        return removed;
+    }
+
+    // Appends a row to a selection, extending the last range when the row directly follows it.
+    // Dense selections stay a handful of ranges, fragmented ones switch to a bitmap over the rows they span.
+    static void appendRow(EmailRowSelection& selection, size_t shard, size_t row);
+
+    // Builds a new view over the rows of this view matching the predicate, without copying any Email
+    template <typename Predicate>
+    EmailListView selectWhere(Predicate predicate) {
+        EmailRowSelection selection;
+        for (auto it = begin(); it != end(); ++it) {
+            if (predicate(std::as_const(*it))) {
+                appendRow(selection, it.shard(), it.row());
+            }
+        }
+        return select(std::move(selection));
+    }
+
+    // Builds a new view over a selection taken from this view. Unlike narrowTo(), the new view is not narrowed.
+    EmailListView select(EmailRowSelection selection) const;
+
+    // Narrows this view, in place, to the rows of it matching the predicate
+    template <typename Predicate>
+    void narrowWhere(Predicate predicate) {
+        EmailRowSelection selection;
+        for (auto it = begin(); it != end(); ++it) {
+            if (predicate(std::as_const(*it))) {
+                appendRow(selection, it.shard(), it.row());
+            }
+        }
+        narrowTo(std::move(selection));
+    }
+
+    // Replaces the rows this view covers with a selection taken from it. Plugins executed with this view
+    // afterwards only see the selection, and the view stops tracking new rows committed by others.
+    void narrowTo(EmailRowSelection selection);
+
+    // Whether narrowTo() has been called on this view
+    bool isNarrowed() const {
+        return narrowed_;
+    }
+
+    // Get the rows this view covers, committed inserts included, as a selection
+    EmailRowSelection getSelection() const;
+
+    // Narrows this view to what slices of it were narrowed to. Each slice is keyed by its offset within this
+    // view, with the number of rows it was taken over, and replaces those rows with its selection (its committed
+    // inserts included). The slices must not overlap, rows of this view outside them are kept.
+    void narrowToSlices(std::map<size_t, std::pair<size_t, EmailRowSelection>> slices);
+
+    // Takes over what a slice of this view gained: the rows it committed past its first baseRowCount rows,
+    // and the inserts it still has queued. Lets plugins run on private slices without losing their inserts.
+    // If the slice was narrowed, it must have been taken over rows [0, baseRowCount), which it then replaces.
+    void absorbSlice(EmailListView& slice, size_t baseRowCount);
 
     // Commit pending inserts to storage
     void commitInserts();
 
-    // Get the size of this view
+    // Get the number of live Emails in this view
     size_t getSize() const;
 
+    // Get the shard row ranges covered by this view. Rows outside a selection mask are included.
+    const std::vector<EmailRowRange>& getRanges() const {
+        return ranges_;
+    }
+
     // Convert to JSON
     nlohmann::json getSimpleEmailJsonList();
-};
\ No newline at end of file
+};
+
+using EmailIterator = EmailListView::Iterator;
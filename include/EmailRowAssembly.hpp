@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "Email.hpp"
+#include "EmailBody.hpp"
+#include "EmailListView.hpp"
+#include "Logger.hpp"
+#include "PluginRunnableInterface.hpp"
+#include "WorkStealingPool.hpp"
+
+/**
+ * @brief Rebuilds emails from the rows of the email tables, and hands them on in batches.
+ *
+ * Shared by the readers of databases laid out like PostgresqlSaver's (PostgresqlReader, SQLiteReader). Each
+ * table is read sorted by emailid and merged against the emails in one pass, so no per-row lookups are needed.
+ */
+namespace EmailRowAssembly {
+    struct PendingPart {
+        int64_t emailpartid;
+        std::string body;
+        std::pmr::map<std::string, std::vector<std::string>> header;
+    };
+
+    struct PendingEmail {
+        int64_t emailid;
+        Email email;
+        std::vector<PendingPart> parts;
+    };
+
+    // Advances a cursor over rows sorted by id to the row with the given id, returning nullptr if there is none.
+    template <typename Row, typename Id>
+    Row* seek(std::vector<Row>& rows, size_t& cursor, Id Row::* id, int64_t wanted) {
+        while (cursor < rows.size() && rows[cursor].*id < wanted) ++cursor;
+        return cursor < rows.size() && rows[cursor].*id == wanted ? &rows[cursor] : nullptr;
+    }
+
+    /**
+     * @brief Merges part header rows into the parts of pending emails.
+     *
+     * Parts are kept in emailid, emailpartid order, so header rows sorted the same way are merged in one pass.
+     * Every part must have been added before the merger is built.
+     */
+    class PartHeaderMerger {
+    public:
+        explicit PartHeaderMerger(std::vector<PendingEmail>& pending) {
+            for (PendingEmail& entry : pending) {
+                for (PendingPart& part : entry.parts) {
+                    partIndex_.emplace_back(part.emailpartid, &part);
+                }
+            }
+        }
+
+        // Adds one header row, a key without a value only creates the key. Returns false once past the last part.
+        bool add(int64_t partId, const std::string& key, std::optional<std::string> value) {
+            while (cursor_ < partIndex_.size() && partIndex_[cursor_].first != partId) ++cursor_;
+            if (cursor_ == partIndex_.size()) return false;
+            std::vector<std::string>& values = partIndex_[cursor_].second->header[key];
+            if (value) values.push_back(std::move(*value));
+            return true;
+        }
+
+    private:
+        std::vector<std::pair<int64_t, PendingPart*>> partIndex_;
+        size_t cursor_ = 0;
+    };
+
+    // Sets the body of a pending email from its parts: all of them for MIME multipart emails, else the first.
+    inline void assembleBody(PendingEmail& entry) {
+        Email& email = entry.email;
+        if (email.getIsMIMEMultipart()) {
+            auto partBodies = std::make_unique<MIMEMultipartBodies>();
+            for (PendingPart& part : entry.parts) {
+                partBodies->addPart(part.header, part.body);
+            }
+            email.setBody(std::move(partBodies));
+        } else {
+            email.setBody(std::make_unique<StandardEmailBody>(entry.parts.empty() ? std::string() : std::move(entry.parts.front().body)));
+        }
+    }
+
+    /**
+     * @brief Hands batches of emails read by a source plugin on to the email list.
+     *
+     * Emails whose unique hash is already in the list, or in an earlier batch, are dropped. The rest are
+     * passed to the sink of a streamed read, then inserted. Each batch is delivered by a task while the next
+     * one is read, so at most two batches are held at a time.
+     */
+    class BatchDelivery {
+    public:
+        BatchDelivery(EmailListView* emailList, const PluginRunnableInterface::BatchSink& sink, std::string reader)
+            : emailList_(emailList), sink_(sink), reader_(std::move(reader)), consumer_(*WorkStealingPool::getInstance()) {
+            for (const auto& email : *emailList_) {
+                knownHashes_.insert(email.getUniqueHash());
+            }
+        }
+
+        void deliver(std::vector<Email>&& emails) {
+            std::erase_if(emails, [this](const Email& newEmail) {
+                if (!knownHashes_.insert(newEmail.getUniqueHash()).second) {
+                    LOG_INFO << "Email already exists: " << newEmail.getUniqueHash();
+                    return true;
+                }
+                return false;
+            });
+            consumer_.wait();
+            auto batch = std::make_shared<std::vector<Email>>(std::move(emails));
+            consumer_.run([this, batch] {
+                if (sink_) {
+                    std::vector<Email*> pointers;
+                    pointers.reserve(batch->size());
+                    for (Email& email : *batch) {
+                        pointers.push_back(&email);
+                    }
+                    if (!sink_(pointers)) {
+                        LOG_ERROR << reader_ << ": a plugin fed by the read failed.";
+                        status_ = false;
+                    }
+                }
+                for (Email& email : *batch) {
+                    emailList_->insertEmail(std::move(email));
+                }
+                emailList_->commitInserts();
+            });
+        }
+
+        // Waits for the last batch. Returns false if a plugin fed by the read failed.
+        bool finish() {
+            consumer_.wait();
+            return status_;
+        }
+
+    private:
+        EmailListView* emailList_;
+        const PluginRunnableInterface::BatchSink& sink_;
+        std::string reader_;
+        std::unordered_set<size_t> knownHashes_;
+        bool status_ = true;
+        TaskGroup consumer_; // Last, so it finishes its tasks before what they use is destroyed.
+    };
+}
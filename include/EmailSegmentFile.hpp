@@ -0,0 +1,56 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+class Email;
+class EmailListView;
+
+/**
+ * @brief Reads and writes emails in Inlook's native segment format, built for fast reopening.
+ *
+ * A segment file holds a fixed header, an index with one fixed-size entry per email, and three
+ * contiguous sections (headers, bodies, attributes) that the index points into by offset:
+ *
+ *     header     magic, email count, offset of each section
+ *     index      per email: unique hash, MIME flag, body kind, offsets into each section
+ *     headers    per email: header count, then (key, value) strings
+ *     bodies     per email: standard body bytes, or the parts of a MIME multipart body
+ *     attributes per email: attribute count, then (name, kind, value); blobs carry their hash
+ *
+ * Loading maps the file instead of reading it. Standard bodies and blob attributes (such as the raw
+ * file bytes) stay in the mapping and are only paged in when first read. Everything else (headers, MIME
+ * parts and serialized attributes) is parsed while loading, and every email is built before the load
+ * returns, so reopening skips parsing the raw emails and reading their bulk, but still scales with the
+ * number of emails and the size of their headers and attributes.
+ */
+class EmailSegmentFile {
+public:
+    /**
+     * @brief Writes every email of a view to a segment file, replacing it atomically.
+     *
+     * Sections are staged in temporary files beside it, so memory use does not grow with the view.
+     *
+     * @param path The file to write.
+     * @param emailList The emails to write.
+     * @return The number of emails written, or nothing if the file could not be written.
+     */
+    static std::optional<size_t> write(const std::filesystem::path& path, EmailListView& emailList);
+
+    /**
+     * @brief Writes emails held outside storage, such as shallow copies taken for a checkpoint.
+     * @param path The file to write.
+     * @param emails The emails to write.
+     * @return The number of emails written, or nothing if the file could not be written.
+     */
+    static std::optional<size_t> write(const std::filesystem::path& path, const std::vector<Email>& emails);
+
+    /**
+     * @brief Maps a segment file and queues its emails for insertion into a view.
+     * @param path The file to load.
+     * @param emailList The view to insert the emails into. They are stored on its next commit.
+     * @return The number of emails loaded, or nothing if the file is missing, foreign or truncated.
+     */
+    static std::optional<size_t> load(const std::filesystem::path& path, EmailListView& emailList);
+};
@@ -1,54 +1,189 @@
 #pragma once
 
+#include <atomic>
+#include <bit>
+#include <cstdint>
 #include <vector>
 #include <string>
+#include <memory>
+#include <mutex>
 #include <shared_mutex>
+#include <thread>
 #include <queue>
 #include "Email.hpp"
+#include "SegmentedVector.hpp"
 #include "nlohmann/json.hpp"
 
 class EmailListView;
+class EmailStorage;
 
+// A contiguous run of rows [begin, end) within one storage shard.
+struct EmailRowRange {
+    size_t shard;
+    size_t begin;
+    size_t end;
+};
+
+// How many rows each shard had published when a snapshot was pinned.
+struct EmailStorageGeneration {
+    uint64_t epoch;
+    std::vector<size_t> shardSizes;
+};
+
+/**
+ * A read-only, pinned generation of EmailStorage.
+ *
+ * Readers only ever see rows that were committed when the generation was published, and never take the
+ * storage lock, so they neither block on nor race with appends. While any snapshot is alive, compaction
+ * is deferred, so the rows it covers cannot move. Removals made after pinning are still skipped.
+ */
+class EmailStorageSnapshot {
+public:
+    ~EmailStorageSnapshot();
+
+    EmailStorageSnapshot(EmailStorageSnapshot&& other) noexcept;
+    EmailStorageSnapshot(const EmailStorageSnapshot&) = delete;
+    EmailStorageSnapshot& operator=(const EmailStorageSnapshot&) = delete;
+
+    // Get the epoch of the pinned generation
+    uint64_t getEpoch() const;
+
+    // Get the number of live Emails in the pinned generation
+    size_t getSize() const;
+
+    nlohmann::json getSimpleEmailJsonList() const;
+
+    nlohmann::json getEmailsByNumber(int start, int num_returned) const;
+
+private:
+    EmailStorageSnapshot(EmailStorage* storage, EmailStorageGeneration generation);
+
+    EmailStorage* storage_;
+    EmailStorageGeneration generation_;
+
+friend class EmailStorage;
+};
+
+/**
+ * Owns every email, partitioned into independently appendable shards.
+ *
+ * Each thread appends to its own shard under that shard's mutex, so parallel ingest does not contend
+ * on one lock. Views stitch the shards together, in shard order, into one logical list.
+ *
+ * Removal only sets a tombstone bit for the row, which views and iterators skip. Rows stay in place
+ * until compact() reclaims them, which it only does once no views are open and no snapshot is pinned.
+ *
+ * Every committed insert publishes its shard's new size with a single atomic store, so writers on
+ * different shards never serialise on publication. Readers that must not wait on a running workflow
+ * (the web UI) read through getSnapshot() instead of a view, which captures the published sizes.
+ */
 class EmailStorage {
 private:
+    struct Shard {
+        std::mutex appendMutex_;
+        SegmentedVector<Email> emails_; // Block-allocated, so appends never relocate existing emails.
+        SegmentedVector<std::atomic<uint64_t>, 64> tombstones_; // One bit per row, set once it is removed.
+        std::atomic<size_t> removedCount_ = 0;
+        std::atomic<size_t> publishedSize_ = 0; // Rows snapshots may read, stored once they are fully appended.
+
+        void append(Email&& email);
+
+        bool isRemoved(size_t row) const {
+            return (tombstones_[row >> 6].load(std::memory_order_relaxed) >> (row & 63)) & 1;
+        }
+
+        // Returns false if the row had already been removed.
+        bool markRemoved(size_t row) {
+            uint64_t bit = uint64_t{1} << (row & 63);
+            if (tombstones_[row >> 6].fetch_or(bit, std::memory_order_relaxed) & bit) return false;
+            removedCount_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // Counts the rows in [begin, end) that have not been removed.
+        size_t countLive(size_t begin, size_t end) const;
+    };
+
+    // Shared by appenders and readers, exclusive only for operations that move emails (removal).
     mutable std::shared_mutex storageMutex_;
-    std::vector<Email> emails_;
-    std::queue<Email> pendingInserts_;
-    bool refresh_full_view_size_(size_t *s, size_t *e);
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::mutex pendingMutex_; // Guards pendingInserts_, taken apart from storageMutex_ so inserting them can lock it.
+    std::vector<Email> pendingInserts_;
+    std::atomic<size_t> openViews_ = 0; // Views hold row ranges, so compaction waits until none are open.
+
+    std::atomic<uint64_t> epoch_ = 0; // Counts publications, bumped after the shard sizes they cover.
+    std::atomic<size_t> pinnedSnapshots_ = 0;
+    std::atomic<bool> compacting_ = false;
+
+    Shard& shardForThisThread();
+    void publish(Shard& shard);
+    std::vector<EmailRowRange> fullRanges() const;
 
 friend class EmailListView;
+friend class EmailStorageSnapshot;
 
 public:
-    EmailStorage() = default;
+    explicit EmailStorage(size_t numShards = std::max(1u, std::thread::hardware_concurrency()));
 
-    // Insert Email (Thread-Safe)
-    void insertEmail(const Email& email) {
-        std::unique_lock lock(storageMutex_);
-        emails_.push_back(email);
-    }
+    // Insert Email by moving it into this thread's shard (Thread-Safe)
+    void insertEmail(Email&& email);
+
+    // Insert a batch of Emails into this thread's shard under a single lock, moving each (Thread-Safe)
+    // Returns the rows the batch now occupies.
+    EmailRowRange insertEmails(std::vector<Email>&& emails);
 
     // Get a full view (Read-Only)
     EmailListView getFullView();
 
+    // Pin the rows published so far for lock-free reading. Only waits if a compaction is running.
+    EmailStorageSnapshot getSnapshot();
+
     // Splits storage into numParts partitions
     std::vector<EmailListView> split(int numParts);
 
     // Commits queued insertions to storage
     void commitPendingInserts();
 
+    // Reads the latest published generation through a snapshot
     nlohmann::json getSimpleEmailJsonList();
 
+    // Reads the latest published generation through a snapshot
     nlohmann::json getEmailsByNumber(int start, int num_returned);
 
-    // Removes Email (Thread-Safe)
-    void removeEmail(const Email& email) {
-        std::unique_lock lock(storageMutex_);
-        emails_.erase(std::remove(emails_.begin(), emails_.end(), email), emails_.end());
-    }
+    // Removes Email by tombstoning every stored copy of it (Thread-Safe)
+    void removeEmail(const Email& email);
+
+    // Tombstones a single row in O(1), returns false if it was already removed (Thread-Safe)
+    bool removeRow(size_t shard, size_t row);
 
-    // Get size (Thread-Safe)
-     int getSize() const {
+    // Tombstones every live Email matching the predicate in one pass, returns how many were removed (Thread-Safe)
+    template <typename Predicate>
+    size_t removeWhere(Predicate predicate) {
         std::shared_lock lock(storageMutex_);
-        return emails_.size();
+        size_t removed = 0;
+        for (auto& shard : shards_) {
+            size_t size = shard->emails_.size();
+            for (size_t row = 0; row < size; ++row) {
+                if (!shard->isRemoved(row) && predicate(std::as_const(shard->emails_[row])) && shard->markRemoved(row)) {
+                    ++removed;
+                }
+            }
+        }
+        return removed;
+    }
+
+    // Reclaims tombstoned rows, returns how many were dropped.
+    // Skipped (returns 0) while any view is open or snapshot is pinned.
+    size_t compact();
+
+    // Get the number of removed rows still awaiting compaction
+    size_t getRemovedCount() const;
+
+    // Get size of the latest published generation, excluding removed Emails (Thread-Safe)
+    int getSize();
+
+    // Get the number of shards emails are partitioned across
+    size_t getShardCount() const {
+        return shards_.size();
     }
-};
\ No newline at end of file
+};
@@ -1,8 +1,10 @@
 #pragma once
 
 #include "nlohmann/json.hpp"
+#include <atomic>
 #include <mutex>
 #include <string>
+#include <thread>
 #include "EmailListView.hpp"
 #include "PluginInterface.hpp"
 #include "EmailStorage.hpp"
@@ -154,11 +156,13 @@ public:
 
 private:
     GlobalConfigManager() : emailStorage_(new EmailStorage) {}
-    ~GlobalConfigManager() = default;
+    ~GlobalConfigManager();
 
     std::shared_ptr<EmailStorage> emailStorage_;
 
     mutable std::mutex mtx_;
+    std::atomic<bool> executing_ = false; // Set while a root execution is running.
+    std::thread rootThread_; // Runs the root workflow, outside the worker pool its executors schedule onto.
     std::pair<std::string, std::shared_ptr<PluginInterface>> rootPluginExecutor_;
 
     std::string GlobalConfigFilename_;
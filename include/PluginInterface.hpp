@@ -4,6 +4,7 @@
 #include "PluginStateManager.hpp"
 
 
+class Email;
 class EmailListView;
 /**
  * @brief Abstract base class for all plugins.
@@ -92,6 +93,44 @@ public:
      */
      virtual std::string getState() const;
 
+    /**
+     * @brief Sets the state on behalf of an executor that does the work of execute() some other way, such as
+     * streaming batches through executeBatch() or applying cached results, as only execute() sets it itself.
+     * @param state The state to move to.
+     */
+     void setExecutionState(const std::string& state);
+
+    /**
+     * @brief Reports whether one instance may execute on several threads at once.
+     *
+     * Parallel executors share thread-safe instances between their workers, and clone every other plugin
+     * from its config once per worker. Only override this if execute() touches no mutable members.
+     *
+     * @return True if execute() may be called concurrently on this instance.
+     */
+     virtual bool isThreadSafe() const { return false; }
+
+    /**
+     * @brief Reports whether the plugin can process emails one at a time through process().
+     *
+     * Executors in streaming mode push batches through consecutive streaming plugins while the batch is
+     * still hot in cache, instead of running each plugin over the whole list in turn.
+     *
+     * @return True if process() is implemented.
+     */
+     virtual bool supportsStreaming() const { return false; }
+
+    /**
+     * @brief Processes a single email, for executors in streaming mode.
+     *
+     * Called for each email in list order, and never concurrently on one instance. Plugins that insert or
+     * remove emails must work on the whole list in execute() instead.
+     *
+     * @param email The email to process.
+     * @return True on success, false on failure.
+     */
+     virtual bool process(Email&) { return false; }
+
 protected:
     /**
      * @brief Protected constructor to prevent direct instantiation.
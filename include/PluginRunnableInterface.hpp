@@ -1,4 +1,6 @@
 #pragma once
+#include <functional>
+#include <span>
 #include <string>
 #include <vector>
 #include "PluginInterface.hpp"
@@ -21,7 +23,69 @@ public:
      * properly destructed.
      */
     ~PluginRunnableInterface() override = default;
+
+    /// Batch size used by executeInBatches() unless a plugin asks for another.
+    static constexpr size_t DEFAULT_BATCH_SIZE = 256;
+
+    /**
+     * @brief Reports whether executors may hand the plugin batches through executeBatch().
+     *
+     * Plugins that process emails one at a time get this for free through the default executeBatch().
+     *
+     * @return True if executeBatch() is usable.
+     */
+    virtual bool supportsBatches() const { return supportsStreaming(); }
+
+    /**
+     * @brief Processes a fixed-size batch of emails.
+     *
+     * Lets a plugin amortize its setup (parsed config, compiled patterns, buffers) over many emails, and
+     * work across emails at once. The default adapter calls process() on each email in turn.
+     *
+     * @param batch The emails of the batch, in list order.
+     * @return True on success, false on failure.
+     */
+    virtual bool executeBatch(std::span<Email*> batch) {
+        for (Email* email : batch) {
+            if (!process(*email)) return false;
+        }
+        return true;
+    }
+
+    /// Receives each batch a source plugin produces, returning false to report a failure.
+    using BatchSink = std::function<bool(std::span<Email*>)>;
+
+    /**
+     * @brief Reports whether the plugin produces its emails batch by batch through executeAsSource().
+     * @return True if executeAsSource() streams batches to its sink.
+     */
+    virtual bool supportsBatchSource() const { return false; }
+
+    /**
+     * @brief Adds emails to a list batch by batch, handing each batch to a sink before inserting it.
+     *
+     * Lets an executor run streaming plugins on the first emails while the rest are still being produced,
+     * e.g. read from a database. Batches reach the sink in order, one at a time. The default produces
+     * nothing for the sink and simply runs execute().
+     *
+     * @param emailList The list the emails are inserted into.
+     * @param sink Called with each batch before it is inserted. May be empty.
+     * @return True on success, false on failure (including a failed sink).
+     */
+    virtual bool executeAsSource(EmailListView* emailList, const BatchSink& sink) {
+        (void)sink;
+        return execute(emailList);
+    }
+
 protected:
+    /**
+     * @brief Runs executeBatch() over a whole list, for plugins implementing execute() through batches.
+     * @param emailList The list to process.
+     * @param batchSize The number of emails per batch.
+     * @return True if every batch succeeded.
+     */
+    bool executeInBatches(EmailListView* emailList, size_t batchSize = DEFAULT_BATCH_SIZE);
+
     /**
      * @brief Protected default constructor.
      *
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <mutex>
 #include <set>
 #include <unordered_map>
 #include <string>
@@ -18,6 +19,7 @@ public:
     std::string getState() const;
 
 private:
+    mutable std::mutex mtx_; // A thread-safe plugin's state may be set from several workers at once.
     std::string currentState;
     std::set<std::string> states;
     std::unordered_map<std::string, std::set<std::string>> transitions;
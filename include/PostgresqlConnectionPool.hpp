@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <pqxx/pqxx>
+
+/**
+ * @brief A fixed set of open PostgreSQL connections, shared by the Postgres plugins.
+ *
+ * Every connection has its search_path set to the plugin's schema when opened, so transactions taken on
+ * a leased connection can use unqualified table names. Connections are handed out one at a time through
+ * a Lease, which returns it to the pool when it goes out of scope.
+ *
+ * Header-only, so only the plugins that include it link against libpqxx.
+ */
+class PostgresqlConnectionPool {
+public:
+    /**
+     * @brief Holds one connection of the pool until destroyed.
+     */
+    class Lease {
+    public:
+        Lease(Lease&& other) noexcept : pool_(other.pool_), connection_(std::exchange(other.connection_, nullptr)) {}
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease& operator=(Lease&&) = delete;
+
+        ~Lease() {
+            if (connection_) pool_->release(connection_);
+        }
+
+        pqxx::connection& operator*() const { return *connection_; }
+        pqxx::connection* operator->() const { return connection_; }
+
+    private:
+        Lease(PostgresqlConnectionPool* pool, pqxx::connection* connection) : pool_(pool), connection_(connection) {}
+
+        PostgresqlConnectionPool* pool_;
+        pqxx::connection* connection_;
+
+    friend class PostgresqlConnectionPool;
+    };
+
+    /**
+     * @brief Opens every connection of the pool.
+     * @param connectionString The libpq connection string ("databasePath" in the plugin configs).
+     * @param schema The schema put first on each connection's search_path.
+     * @param size Number of connections, at least one is always opened.
+     * @throws pqxx::broken_connection if a connection cannot be opened.
+     */
+    PostgresqlConnectionPool(const std::string& connectionString, const std::string& schema, size_t size) {
+        size = std::max<size_t>(size, 1);
+        for (size_t i = 0; i < size; ++i) {
+            auto connection = std::make_unique<pqxx::connection>(connectionString);
+            pqxx::nontransaction setup(*connection);
+            setup.exec("SET search_path TO " + setup.quote_name(schema) + ", public");
+            idle_.push_back(connection.get());
+            connections_.push_back(std::move(connection));
+        }
+    }
+
+    PostgresqlConnectionPool(const PostgresqlConnectionPool&) = delete;
+    PostgresqlConnectionPool& operator=(const PostgresqlConnectionPool&) = delete;
+
+    /**
+     * @brief Takes a connection, waiting for one to be returned if all are leased.
+     * @return The lease on the connection.
+     */
+    Lease acquire() {
+        std::unique_lock lock(mtx_);
+        available_.wait(lock, [this] { return !idle_.empty(); });
+        pqxx::connection* connection = idle_.back();
+        idle_.pop_back();
+        return Lease(this, connection);
+    }
+
+    /**
+     * @brief Prepares a statement on every connection, so it is parsed and planned once per connection.
+     *
+     * Must be called while no connection is leased.
+     *
+     * @param name The name the statement is executed under.
+     * @param definition The SQL of the statement, with $1, $2, ... placeholders.
+     */
+    void prepare(const std::string& name, const std::string& definition) {
+        std::lock_guard lock(mtx_);
+        for (auto& connection : connections_) {
+            connection->prepare(name, definition);
+        }
+    }
+
+    /**
+     * @brief Names a dataset as a destination for Email's per-destination dirty tracking.
+     *
+     * Shared by the reader and the saver, so emails read from a dataset are clean for saves back into it.
+     *
+     * @param connectionString The libpq connection string ("databasePath" in the plugin configs).
+     * @param schema The schema of the dataset.
+     * @param datasetName The dataset.
+     * @return The destination name.
+     */
+    static std::string makeDestination(const std::string& connectionString, const std::string& schema, const std::string& datasetName) {
+        return "postgresql:" + connectionString + "/" + schema + "/" + datasetName;
+    }
+
+    /**
+     * @brief Retrieves the number of connections in the pool.
+     * @return The number of connections.
+     */
+    size_t getSize() const {
+        return connections_.size();
+    }
+
+private:
+    void release(pqxx::connection* connection) {
+        {
+            std::lock_guard lock(mtx_);
+            idle_.push_back(connection);
+        }
+        available_.notify_one();
+    }
+
+    std::vector<std::unique_ptr<pqxx::connection>> connections_;
+    std::vector<pqxx::connection*> idle_;
+    std::mutex mtx_;
+    std::condition_variable available_;
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "nlohmann/json.hpp"
+
+class Email;
+class EmailListView;
+class PluginInterface;
+
+/**
+ * @brief An on-disk store of the attributes plugins generated, for skipping work on re-runs.
+ *
+ * Entries are keyed by the plugin name, its canonical config, the email's unique hash and the values of
+ * the plugin's declared input attributes, so an entry only matches while none of those have changed.
+ * Entries are appended to a single log file and indexed by offset on open, so the store never holds
+ * cached values in memory. On open, the log is rewritten without superseded entries once they make up
+ * half of it, and without its oldest entries if it is over the size cap. While open, results are no longer
+ * stored once the log reaches the cap.
+ *
+ * Only plugins that declare the attributes they generate are cached, as those attributes are all that
+ * is recorded. Thread-safe.
+ */
+class ResultCache {
+public:
+    /// Attribute names with their values as produced by AttributeBagValueInterface::serializeToString().
+    using Attributes = std::vector<std::pair<std::string, std::string>>;
+
+    /**
+     * @brief Gets the process-wide cache, stored under "result_cache_dir" from the global config and
+     * capped at "result_cache_max_mb" megabytes (0 or absent for no cap).
+     * @return Pointer to the shared cache.
+     */
+    static ResultCache* getInstance();
+
+    /**
+     * @brief Opens the cache in a directory, indexing every complete entry already written there.
+     * @param directory Directory holding the cache log, created if missing.
+     * @param maxBytes Size cap of the log, 0 for none.
+     */
+    explicit ResultCache(const std::filesystem::path& directory, uint64_t maxBytes = 0);
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    /**
+     * @brief Computes the key of a plugin's result for one email.
+     *
+     * Stable across runs and builds, as it is persisted.
+     *
+     * @param plugin The plugin.
+     * @param email The email, before the plugin has run on it.
+     * @return The key.
+     */
+    static uint64_t makeKey(PluginInterface& plugin, const Email& email);
+
+    /**
+     * @brief Looks up a cached result.
+     * @param key The key, from makeKey().
+     * @param attributes Filled with the cached attributes on a hit.
+     * @return True on a hit.
+     */
+    bool lookup(uint64_t key, Attributes& attributes);
+
+    /**
+     * @brief Records a result. Buffered until flush().
+     * @param key The key, from makeKey().
+     * @param attributes The attributes the plugin generated.
+     */
+    void store(uint64_t key, const Attributes& attributes);
+
+    /**
+     * @brief Writes buffered entries through to disk.
+     */
+    void flush();
+
+    /**
+     * @brief Executes a plugin over only the emails it has no cached result for.
+     *
+     * Cached attributes are applied straight to the hit emails, the plugin runs on a view narrowed to the
+     * misses, and what it generated for them is stored. Plugins not declaring generated attributes,
+     * including executors, are simply executed.
+     *
+     * @param plugin The plugin to execute.
+     * @param emailList The list to run it over.
+     * @return The plugin's status, or true if every email was a hit.
+     */
+    bool executeCached(PluginInterface& plugin, EmailListView* emailList);
+
+    /**
+     * @brief Retrieves the number of entries in the cache.
+     * @return The number of entries.
+     */
+    size_t getEntryCount() const;
+
+private:
+    // Declared generated attributes, or empty if the plugin's results cannot be cached.
+    static std::vector<std::string> getCachedAttributes(PluginInterface& plugin);
+
+    // Rewrites the log with only the newest entry of each key, dropping the oldest ones over the cap.
+    void compact(const std::unordered_map<uint64_t, uint64_t>& entrySizes);
+
+    mutable std::mutex mtx_;
+    std::filesystem::path logPath_;
+    std::unordered_map<uint64_t, uint64_t> index_; // Key to the offset of its newest entry in the log.
+    std::ofstream writer_;
+    std::ifstream reader_;
+    uint64_t logSize_ = 0;
+    uint64_t maxBytes_;
+    bool full_ = false; // Reached maxBytes_, new results are not stored until the next open.
+    bool unflushed_ = false;
+};
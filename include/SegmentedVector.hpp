@@ -0,0 +1,225 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <compare>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @class SegmentedVector
+ * @brief An append-only sequence stored in fixed-size blocks that never relocate.
+ *
+ * Elements live in blocks of BlockSize slots, reached through a block index. Appending only ever
+ * constructs into the current block or allocates a new one, so existing elements keep their address
+ * and iterators stay valid while the sequence grows. When the block index fills up it is replaced by
+ * a larger copy rather than reallocated in place; superseded indexes are retired (kept alive until
+ * destruction) so a reader that loaded an older index can keep using it.
+ *
+ * Appends must be serialized by the caller. Readers may access any element below size() concurrently
+ * with an append, as the element is published only after it has been fully constructed.
+ *
+ * @tparam T The element type.
+ * @tparam BlockSize Number of elements per block, must be a power of two.
+ */
+template <typename T, size_t BlockSize = 1024>
+class SegmentedVector {
+    static_assert(std::has_single_bit(BlockSize), "BlockSize must be a power of two.");
+    static constexpr size_t BLOCK_SHIFT = std::countr_zero(BlockSize);
+    static constexpr size_t BLOCK_MASK = BlockSize - 1;
+    static constexpr size_t INITIAL_INDEX_CAPACITY = 16;
+
+    struct Block {
+        alignas(T) std::byte storage[sizeof(T) * BlockSize];
+
+        T* slot(size_t offset) {
+            return std::launder(reinterpret_cast<T*>(storage) + offset);
+        }
+    };
+
+public:
+    template <bool IsConst>
+    class Iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using iterator_concept = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<IsConst, const T*, T*>;
+        using reference = std::conditional_t<IsConst, const T&, T&>;
+        using Container = std::conditional_t<IsConst, const SegmentedVector, SegmentedVector>;
+
+        Iterator() = default;
+        Iterator(Container* container, size_t index) : container_(container), index_(index) {}
+
+        // Allows iterator -> const_iterator conversion.
+        operator Iterator<true>() const { return Iterator<true>(container_, index_); }
+
+        reference operator*() const { return (*container_)[index_]; }
+        pointer operator->() const { return &(*container_)[index_]; }
+        reference operator[](difference_type n) const { return (*container_)[index_ + n]; }
+
+        Iterator& operator++() { ++index_; return *this; }
+        Iterator operator++(int) { Iterator tmp = *this; ++index_; return tmp; }
+        Iterator& operator--() { --index_; return *this; }
+        Iterator operator--(int) { Iterator tmp = *this; --index_; return tmp; }
+        Iterator& operator+=(difference_type n) { index_ += n; return *this; }
+        Iterator& operator-=(difference_type n) { index_ -= n; return *this; }
+
+        friend Iterator operator+(Iterator it, difference_type n) { return it += n; }
+        friend Iterator operator+(difference_type n, Iterator it) { return it += n; }
+        friend Iterator operator-(Iterator it, difference_type n) { return it -= n; }
+        friend difference_type operator-(const Iterator& a, const Iterator& b) {
+            return static_cast<difference_type>(a.index_) - static_cast<difference_type>(b.index_);
+        }
+
+        bool operator==(const Iterator& other) const { return index_ == other.index_; }
+        auto operator<=>(const Iterator& other) const { return index_ <=> other.index_; }
+
+        /// Position of the iterator within the container.
+        size_t index() const { return index_; }
+
+    private:
+        Container* container_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    SegmentedVector() {
+        index_.store(allocateIndex(INITIAL_INDEX_CAPACITY), std::memory_order_relaxed);
+        indexCapacity_ = INITIAL_INDEX_CAPACITY;
+    }
+
+    ~SegmentedVector() {
+        clear();
+        Block** index = index_.load(std::memory_order_relaxed);
+        for (size_t b = 0; b < blockCount_; ++b) {
+            delete index[b];
+        }
+        delete[] index;
+    }
+
+    SegmentedVector(const SegmentedVector&) = delete;
+    SegmentedVector& operator=(const SegmentedVector&) = delete;
+
+    /**
+     * @brief Constructs an element in place at the end of the sequence.
+     *
+     * Never moves existing elements. Must not be called concurrently with another writer.
+     *
+     * @return Reference to the new element.
+     */
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+        size_t position = size_.load(std::memory_order_relaxed);
+        size_t blockIdx = position >> BLOCK_SHIFT;
+        if (blockIdx == blockCount_) {
+            appendBlock();
+        }
+        T* element = new (index_.load(std::memory_order_relaxed)[blockIdx]->slot(position & BLOCK_MASK))
+            T(std::forward<Args>(args)...);
+        size_.store(position + 1, std::memory_order_release); // Publish only once constructed.
+        return *element;
+    }
+
+    void push_back(T&& value) {
+        emplace_back(std::move(value));
+    }
+
+    /**
+     * @brief Retrieves the number of published elements.
+     * @return The number of elements.
+     */
+    size_t size() const {
+        return size_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    T& operator[](size_t position) {
+        return *index_.load(std::memory_order_acquire)[position >> BLOCK_SHIFT]->slot(position & BLOCK_MASK);
+    }
+
+    const T& operator[](size_t position) const {
+        return *index_.load(std::memory_order_acquire)[position >> BLOCK_SHIFT]->slot(position & BLOCK_MASK);
+    }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, size()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+
+    /**
+     * @brief Removes every element matching a predicate, keeping the survivors in order.
+     *
+     * Survivors are compacted towards the front, so this does move elements and invalidates references
+     * past the first removed element. Callers must hold off all readers while it runs.
+     *
+     * @param predicate Returns true for elements to remove.
+     * @return The number of elements removed.
+     */
+    template <typename Predicate>
+    size_t eraseIf(Predicate predicate) {
+        size_t count = size_.load(std::memory_order_relaxed);
+        size_t kept = 0;
+        for (size_t i = 0; i < count; ++i) {
+            T& element = (*this)[i];
+            if (predicate(std::as_const(element))) continue;
+            if (kept != i) (*this)[kept] = std::move(element);
+            ++kept;
+        }
+        truncate(kept);
+        return count - kept;
+    }
+
+    /**
+     * @brief Destroys all elements past newSize. Blocks are kept for reuse.
+     * @param newSize The number of elements to keep.
+     */
+    void truncate(size_t newSize) {
+        size_t count = size_.load(std::memory_order_relaxed);
+        if (newSize >= count) return;
+        size_.store(newSize, std::memory_order_release);
+        for (size_t i = newSize; i < count; ++i) {
+            std::destroy_at(&(*this)[i]);
+        }
+    }
+
+    void clear() {
+        truncate(0);
+    }
+
+private:
+    static Block** allocateIndex(size_t capacity) {
+        return new Block*[capacity]();
+    }
+
+    void appendBlock() {
+        Block** index = index_.load(std::memory_order_relaxed);
+        if (blockCount_ == indexCapacity_) { // Copy into a bigger index instead of growing in place.
+            size_t newCapacity = indexCapacity_ * 2;
+            Block** grown = allocateIndex(newCapacity);
+            std::copy(index, index + blockCount_, grown);
+            retiredIndexes_.emplace_back(index);
+            index_.store(grown, std::memory_order_release);
+            index = grown;
+            indexCapacity_ = newCapacity;
+        }
+        index[blockCount_++] = new Block;
+    }
+
+    std::atomic<Block**> index_;                          ///< Current block index.
+    std::vector<std::unique_ptr<Block*[]>> retiredIndexes_; ///< Superseded indexes, kept for in-flight readers.
+    size_t indexCapacity_ = 0;
+    size_t blockCount_ = 0;
+    std::atomic<size_t> size_ = 0;
+};
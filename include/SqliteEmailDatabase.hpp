@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <sqlite3.h>
+
+/**
+ * @brief An SQLite database file holding datasets in the same tables as the Postgres plugins.
+ *
+ * The file and its tables are created on open if missing, so no setup is needed. It runs in WAL mode with
+ * synchronous=NORMAL, so a commit appends to the log instead of syncing the whole database, and readers
+ * are not blocked by a writer.
+ *
+ * Header-only, so only the plugins that include it use SQLite.
+ */
+class SqliteEmailDatabase {
+public:
+    /**
+     * @brief A prepared statement, compiled once and reset between executions.
+     */
+    class Statement {
+    public:
+        Statement(Statement&& other) noexcept : db_(other.db_), stmt_(std::exchange(other.stmt_, nullptr)) {}
+        Statement(const Statement&) = delete;
+        Statement& operator=(const Statement&) = delete;
+        Statement& operator=(Statement&&) = delete;
+
+        ~Statement() {
+            sqlite3_finalize(stmt_);
+        }
+
+        Statement& bind(int index, int64_t value) {
+            check(db_, sqlite3_bind_int64(stmt_, index, value));
+            return *this;
+        }
+
+        Statement& bind(int index, std::string_view text) {
+            check(db_, sqlite3_bind_text(stmt_, index, text.data(), static_cast<int>(text.size()), SQLITE_TRANSIENT));
+            return *this;
+        }
+
+        Statement& bindBlob(int index, std::string_view bytes) {
+            check(db_, sqlite3_bind_blob(stmt_, index, bytes.data(), static_cast<int>(bytes.size()), SQLITE_TRANSIENT));
+            return *this;
+        }
+
+        /**
+         * @brief Advances to the next result row.
+         * @return True if a row is available, false once the statement has finished.
+         * @throws std::runtime_error if the statement fails.
+         */
+        bool step() {
+            int rc = sqlite3_step(stmt_);
+            if (rc == SQLITE_ROW) return true;
+            if (rc != SQLITE_DONE) check(db_, rc);
+            return false;
+        }
+
+        /**
+         * @brief Runs a statement that returns no rows, then resets it for the next execution.
+         */
+        void execute() {
+            step();
+            reset();
+        }
+
+        void reset() {
+            sqlite3_reset(stmt_);
+            sqlite3_clear_bindings(stmt_);
+        }
+
+        int64_t getInt(int column) const {
+            return sqlite3_column_int64(stmt_, column);
+        }
+
+        bool isNull(int column) const {
+            return sqlite3_column_type(stmt_, column) == SQLITE_NULL;
+        }
+
+        // Text and blob columns alike.
+        std::string getString(int column) const {
+            const void* data = sqlite3_column_blob(stmt_, column);
+            return data ? std::string(static_cast<const char*>(data), sqlite3_column_bytes(stmt_, column)) : std::string();
+        }
+
+    private:
+        Statement(sqlite3* db, const std::string& sql) : db_(db) {
+            check(db_, sqlite3_prepare_v3(db_, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt_, nullptr));
+        }
+
+        sqlite3* db_;
+        sqlite3_stmt* stmt_ = nullptr;
+
+    friend class SqliteEmailDatabase;
+    };
+
+    /**
+     * @brief Opens (creating if needed) the database file and its tables.
+     * @param path The database file.
+     * @throws std::runtime_error if the file cannot be opened or the schema cannot be created.
+     */
+    explicit SqliteEmailDatabase(const std::string& path) {
+        int rc = sqlite3_open_v2(path.c_str(), &db_, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr);
+        if (rc != SQLITE_OK) {
+            std::string message = db_ ? sqlite3_errmsg(db_) : sqlite3_errstr(rc);
+            sqlite3_close_v2(db_);
+            throw std::runtime_error("Unable to open " + path + ": " + message);
+        }
+        sqlite3_busy_timeout(db_, 5000);
+        exec("PRAGMA journal_mode=WAL");
+        exec("PRAGMA synchronous=NORMAL");
+        exec(SCHEMA);
+    }
+
+    ~SqliteEmailDatabase() {
+        sqlite3_close_v2(db_);
+    }
+
+    SqliteEmailDatabase(const SqliteEmailDatabase&) = delete;
+    SqliteEmailDatabase& operator=(const SqliteEmailDatabase&) = delete;
+
+    /**
+     * @brief Runs one or more statements that take no parameters.
+     * @throws std::runtime_error if a statement fails.
+     */
+    void exec(const std::string& sql) {
+        char* error = nullptr;
+        if (sqlite3_exec(db_, sql.c_str(), nullptr, nullptr, &error) != SQLITE_OK) {
+            std::string message = error ? error : sqlite3_errmsg(db_);
+            sqlite3_free(error);
+            throw std::runtime_error("SQLite: " + message);
+        }
+    }
+
+    Statement prepare(const std::string& sql) {
+        return Statement(db_, sql);
+    }
+
+    // Name a dataset of a database file as a destination for Email's per-destination dirty tracking
+    static std::string makeDestination(const std::string& path, const std::string& datasetName) {
+        return "sqlite:" + path + "/" + datasetName;
+    }
+
+    // Check whether a transaction is open on this connection
+    bool isInTransaction() const {
+        return sqlite3_get_autocommit(db_) == 0;
+    }
+
+    // Get the rowid, and so the id, of the last row inserted on this connection
+    int64_t getLastInsertId() const {
+        return sqlite3_last_insert_rowid(db_);
+    }
+
+private:
+    static void check(sqlite3* db, int rc) {
+        if (rc != SQLITE_OK) {
+            throw std::runtime_error(std::string("SQLite: ") + sqlite3_errmsg(db));
+        }
+    }
+
+    // The Postgres plugins' tables, with INTEGER PRIMARY KEY ids (rowid aliases) and the indexes their lookups need.
+    static constexpr const char* SCHEMA = R"(
+        CREATE TABLE IF NOT EXISTS dataset (datasetid INTEGER PRIMARY KEY, datasetname TEXT NOT NULL, datasetdescription TEXT, lastupdateddatetime TEXT);
+        CREATE TABLE IF NOT EXISTS email (emailid INTEGER PRIMARY KEY, datasetid INTEGER NOT NULL, fileidentifier TEXT, filedatetime TEXT,
+                                          ismimemultipart INTEGER NOT NULL DEFAULT 0, uniquehash INTEGER);
+        CREATE TABLE IF NOT EXISTS emailheaderkey (emailheaderkeyid INTEGER PRIMARY KEY, emailid INTEGER NOT NULL, headerkey TEXT);
+        CREATE TABLE IF NOT EXISTS emailheaderval (headerkeyid INTEGER NOT NULL, headerval TEXT);
+        CREATE TABLE IF NOT EXISTS emailpart (emailpartid INTEGER PRIMARY KEY, emailid INTEGER NOT NULL, partbody BLOB);
+        CREATE TABLE IF NOT EXISTS emailpartheaderkey (emailpartheaderkeyid INTEGER PRIMARY KEY, emailpartid INTEGER NOT NULL, headerkey TEXT);
+        CREATE TABLE IF NOT EXISTS emailpartheaderval (emailpartheaderkeyid INTEGER NOT NULL, headerval TEXT);
+        CREATE TABLE IF NOT EXISTS attributebag (emailid INTEGER NOT NULL, attributekey TEXT NOT NULL, attributeval BLOB, datemodified TEXT);
+        CREATE INDEX IF NOT EXISTS dataset_datasetname ON dataset (datasetname);
+        CREATE INDEX IF NOT EXISTS email_datasetid_uniquehash ON email (datasetid, uniquehash);
+        CREATE INDEX IF NOT EXISTS emailheaderkey_emailid ON emailheaderkey (emailid);
+        CREATE INDEX IF NOT EXISTS emailheaderval_headerkeyid ON emailheaderval (headerkeyid);
+        CREATE INDEX IF NOT EXISTS emailpart_emailid ON emailpart (emailid);
+        CREATE INDEX IF NOT EXISTS emailpartheaderkey_emailpartid ON emailpartheaderkey (emailpartid);
+        CREATE INDEX IF NOT EXISTS emailpartheaderval_emailpartheaderkeyid ON emailpartheaderval (emailpartheaderkeyid);
+        CREATE UNIQUE INDEX IF NOT EXISTS attributebag_emailid_attributekey ON attributebag (emailid, attributekey);
+    )";
+
+    sqlite3* db_ = nullptr;
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+/**
+ * @brief FNV-1a hashing for values Inlook persists (result cache keys, checkpoint names, email and blob
+ * hashes), which must not change between builds the way std::hash may.
+ */
+namespace StableHash {
+    constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+    constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+    // Hashes one field onto hash, then a separator, so ("ab", "c") and ("a", "bc") differ.
+    inline uint64_t fnv1a(uint64_t hash, std::string_view bytes) {
+        for (unsigned char byte : bytes) {
+            hash = (hash ^ byte) * FNV_PRIME;
+        }
+        return (hash ^ 0xff) * FNV_PRIME;
+    }
+
+    inline uint64_t fnv1a(uint64_t hash, uint64_t value) {
+        return fnv1a(hash, std::string_view(reinterpret_cast<const char*>(&value), sizeof(value)));
+    }
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A fixed set of worker threads, each with its own task deque.
+ *
+ * A worker runs the newest task in its own deque first (tasks spawned from a task stay hot in cache)
+ * and, once that is empty, steals the oldest task from another worker's deque. Tasks submitted from
+ * outside the pool are dealt round-robin across the deques.
+ *
+ * The process shares one pool, from getInstance(), so nested executors and plugins draw on the same
+ * workers instead of each spawning their own threads.
+ */
+class WorkStealingPool {
+public:
+    /**
+     * @brief Gets the process-wide pool, created on first use with the settings given to configure().
+     *
+     * @return Pointer to the shared pool.
+     */
+    static WorkStealingPool* getInstance();
+
+    /**
+     * @brief Sets how the process-wide pool is started. Only takes effect before the first getInstance().
+     * @param numWorkers Number of workers, 0 for one per hardware thread.
+     * @param pinWorkers If true, the workers are pinned to cores.
+     * @return False if the pool has already started, in which case it keeps its settings.
+     */
+    static bool configure(size_t numWorkers, bool pinWorkers);
+
+    /**
+     * @brief Starts the worker threads.
+     * @param numWorkers Number of workers, at least one is always started.
+     * @param pinWorkers If true, worker i is pinned to core i (modulo the core count). Linux only.
+     */
+    explicit WorkStealingPool(size_t numWorkers, bool pinWorkers = false);
+
+    /**
+     * @brief Runs every task still queued, then joins the workers.
+     */
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    /**
+     * @brief Queues a task. From a worker of this pool it goes on that worker's own deque.
+     * @param task The task to run.
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * @brief Retrieves the number of worker threads.
+     * @return The number of workers.
+     */
+    size_t getWorkerCount() const;
+
+    /**
+     * @brief Checks whether the calling thread is one of this pool's workers.
+     * @return True on a worker thread.
+     */
+    bool isWorkerThread() const;
+
+private:
+    struct Worker {
+        std::mutex mtx;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool tryPop(size_t self, std::function<void()>& task);
+    void runTask(std::function<void()>& task);
+    void workerLoop(size_t index);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    std::atomic<size_t> queued_ = 0;
+    std::atomic<size_t> nextQueue_ = 0;
+    bool stopping_ = false;
+
+    static inline std::mutex configMutex_;
+    static inline size_t configuredWorkers_ = 0;
+    static inline bool configuredPinning_ = false;
+    static inline bool started_ = false;
+
+    static inline thread_local WorkStealingPool* currentPool_ = nullptr;
+    static inline thread_local size_t currentWorker_ = 0;
+};
+
+/**
+ * @brief Tracks completion of a set of tasks submitted to a WorkStealingPool.
+ *
+ * Tasks may add further tasks to the group while it is being waited on. The first exception thrown
+ * by a task is rethrown from wait(). The group queues its own tasks and only hands the pool a ticket
+ * to run the next one, so the waiting thread can run the group's queued tasks itself. It never picks
+ * up unrelated work that could outlast the group, and nested waits cannot starve the pool.
+ */
+class TaskGroup {
+public:
+    explicit TaskGroup(WorkStealingPool& pool);
+
+    /**
+     * @brief Waits for any outstanding tasks, discarding their exceptions.
+     */
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    /**
+     * @brief Submits a task as part of this group.
+     * @param task The task to run.
+     */
+    void run(std::function<void()> task);
+
+    /**
+     * @brief Runs the group's queued tasks until every task in it, including ones added while waiting, has
+     * finished. Sleeps, rather than polls, while the remaining tasks run on other threads.
+     * @throws The first exception thrown by a task of the group.
+     */
+    void wait();
+
+    /**
+     * @brief Retrieves the number of tasks of this group that have finished.
+     * @return The number of completed tasks.
+     */
+    size_t getCompletedCount() const;
+
+private:
+    // Shared with the tickets in the pool, which may run after the group is gone and find nothing left to do.
+    struct State {
+        std::mutex mtx;
+        std::condition_variable changed; // Signalled when a task is queued or the last one finishes.
+        std::deque<std::function<void()>> queue;
+        size_t pending = 0; // Queued or running.
+        std::atomic<size_t> completed = 0;
+        std::exception_ptr error;
+
+        // Runs the next queued task, if any, and returns with lock held again.
+        bool runNext(std::unique_lock<std::mutex>& lock);
+    };
+
+    WorkStealingPool& pool_;
+    std::shared_ptr<State> state_ = std::make_shared<State>();
+};
@@ -96,6 +96,10 @@ bool AttributeBagLogger::execute(EmailListView * emailList) {
                 if (files["file"].get<std::string>() == email.getAttributeValue("File identifier")->toString()) {
                     for (const auto& attKeys : email.getAttributeKeys()) {
                         try {
+                            if (auto* blob = dynamic_cast<AttributeBagBlob*>(email.getAttributeValue(attKeys).get())) {
+                                LOG_INFO << attKeys << ": <" << blob->getBlob()->size() << " bytes>"; // Don't dump raw bytes.
+                                continue;
+                            }
                             std::string attVal = email.getAttributeValue(attKeys)->toString();
                             LOG_INFO << attKeys << ": " << attVal;
                         } catch (const std::exception& e) {
@@ -13,6 +13,10 @@ public:
 
     bool execute(EmailListView * emailList) override;
 
+    bool supportsStreaming() const override { return true; }
+    bool process(Email& email) override;
+    bool executeBatch(std::span<Email*> batch) override;
+
 private:
     struct Register {
         Register() {
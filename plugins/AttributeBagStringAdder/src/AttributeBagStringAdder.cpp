@@ -82,11 +82,26 @@ nlohmann::json AttributeBagStringAdder::printRecursiveInstanceTreeJson() {
 
 bool AttributeBagStringAdder::execute(EmailListView * emailList) {
     SET_PLUGIN_STATE("RUNNING");
-    for (Email& email : *emailList) {
-        for (const auto& attribute : optionConfig_["attributes"]) {
-            email.insertAttribute(attribute["attributeKey"].get<std::string>(), std::make_unique<AttributeBagString>(AttributeBagString(attribute["attributeVal"].get<std::string>())));
+    bool status = executeInBatches(emailList);
+    status ? SET_PLUGIN_STATE("COMPLETE") : SET_PLUGIN_STATE("FAILED");
+    return status;
+}
+
+bool AttributeBagStringAdder::process(Email& email) {
+    Email* single = &email;
+    return executeBatch({&single, 1});
+}
+
+bool AttributeBagStringAdder::executeBatch(std::span<Email*> batch) {
+    // Read the config once per batch rather than once per email.
+    std::vector<std::pair<std::string, std::string>> attributes;
+    for (const auto& attribute : optionConfig_["attributes"]) {
+        attributes.emplace_back(attribute["attributeKey"].get<std::string>(), attribute["attributeVal"].get<std::string>());
+    }
+    for (Email* email : batch) {
+        for (const auto& [key, value] : attributes) {
+            email->insertAttribute(key, std::make_unique<AttributeBagString>(value));
         }
     }
-    SET_PLUGIN_STATE("COMPLETE");
     return true;
 }
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+#include <mutex>
+#include "OrderedStringToPluginInterfaceMap.hpp"
+#include "PluginExecutorInterface.hpp"
+#include "PluginRegistry.hpp"
+#include "WorkStealingPool.hpp"
+
+class DagPluginExecutor final : public PluginExecutorInterface {
+public:
+    explicit DagPluginExecutor(const std::string&);
+    ~DagPluginExecutor() override = default;
+
+    bool execute(EmailListView * emailList) override;  // Executes all plugins, independent ones concurrently
+
+    bool instantiateRecursive() override;
+
+    void clearAllInstances() override;
+    nlohmann::json printRecursiveInstanceTreeJson() override;
+
+    // Plugin Management (CRUD)
+    std::shared_ptr<PluginInterface> getInstantiatedPluginByID(const std::string& pluginInstanceID) override;
+    void updateInstantiatedPluginConfig(const std::string& pluginInstanceID, const nlohmann::json& newOptions) override;
+    void removeInstantiatedPlugin(const std::string& pluginInstanceID) override;
+
+    std::string getInstantiatedPluginConfig(const std::string& pluginInstanceID) override;
+    bool reloadPluginsFromConfig() override;
+
+    // State Management
+    std::string getInstantiatedPluginStatus(const std::string &pluginInstanceID) override;
+    std::vector<std::string> listPluginsByID() override;
+
+    bool executeOne(EmailListView *, std::string) override;
+
+private:
+    // One plugin of the graph, and the plugins that must finish before it may start.
+    struct Node {
+        std::string instanceID;
+        std::shared_ptr<PluginInterface> plugin;
+        std::vector<size_t> dependencies;
+        std::vector<size_t> dependents;
+    };
+
+    // Rebuilds graph_ from managedPlugins_, in configured order.
+    void buildGraph();
+    // True if the later plugin has to wait for the earlier one, judged from their declared attributes.
+    static bool dependsOn(const PluginInterface& later, const PluginInterface& earlier);
+    // Runs one node on its own slice of the list, then hands what it inserted back to the list.
+    bool runNode(Node& node, EmailListView* emailList, std::mutex& listMutex);
+
+    struct Register {
+        Register() {
+            std::string name = "DagPluginExecutor";
+            LOG_DEBUG_VERBOSE << "Registering plugin " << name;
+            Plugins->registerPlugin(name, [](const std::string& instanceID) -> PluginInterface* {
+                return new DagPluginExecutor(instanceID);
+            });
+        }
+    };
+    static inline Register reg;
+
+    OrderedStringToPluginInterfaceMap managedPlugins_ = {}; // Ordered list of plugins
+    std::vector<Node> graph_;
+};
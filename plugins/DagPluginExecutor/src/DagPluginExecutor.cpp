@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iterator>
+
+#include "DagPluginExecutor.hpp"
+#include "Logger.hpp"
+#include "EmailListView.hpp"
+#include "PluginInterface.hpp"
+#include "PluginRegistry.hpp"
+
+DagPluginExecutor::DagPluginExecutor(const std::string& instanceID) : PluginExecutorInterface(instanceID) {
+    pluginName_ = "DagPluginExecutor";
+    instanceID_ = instanceID;
+    interfaces_implemented_ = {"PluginExecutorInterface", "PluginInterface"};
+    Plugins->insertInterfacesImplemented(pluginName_, interfaces_implemented_);
+    optionSchema_ = R"(
+{
+    "$schema": "https://json-schema.org/draft/2020-12/schema",
+    "type": "object",
+    "properties": {
+        "plugins": {
+            "type": "array",
+            "description": "List of plugins to be executed by this executor. Plugins run as soon as every earlier plugin they depend on has finished.",
+            "items": {
+                "type": "object",
+                "properties": {
+                    "name": {
+                        "type": "string",
+                        "description": "The name of the plugin to be executed."
+                    },
+                    "options": {
+                        "type": "object",
+                        "description": "Configuration options for this plugin.",
+                        "additionalProperties": true
+                    }
+                },
+                "required": [
+                    "name"
+                ],
+                "additionalProperties": false
+            }
+        }
+    },
+    "required": [
+        "plugins"
+    ],
+    "additionalProperties": true
+}
+)"_json;
+    SET_PLUGIN_STATE("LOADED");
+}
+
+bool DagPluginExecutor::instantiateRecursive() {
+    bool status = reloadPluginsFromConfig();
+    for (auto plugin : managedPlugins_) {
+        status &= plugin.second->instantiateRecursive();
+    }
+    buildGraph();
+    status? SET_PLUGIN_STATE("READY") : SET_PLUGIN_STATE("FAILED");
+    return status;
+}
+
+bool DagPluginExecutor::dependsOn(const PluginInterface& later, const PluginInterface& earlier) {
+    std::vector<std::string> laterInputs = later.getInputAttributes();
+    std::vector<std::string> laterOutputs = later.getOutputAttributes();
+    std::vector<std::string> earlierInputs = earlier.getInputAttributes();
+    std::vector<std::string> earlierOutputs = earlier.getOutputAttributes();
+
+    // A plugin declaring no attributes at all (executors, loaders, filters) could touch anything, so it
+    // is a barrier in configured order.
+    if (laterOutputs.empty() || earlierOutputs.empty()) return true;
+
+    auto contains = [](const std::vector<std::string>& attributes, const std::string& attribute) {
+        return std::find(attributes.begin(), attributes.end(), attribute) != attributes.end();
+    };
+    // Outputs include inputs, so what a plugin writes is its outputs less its inputs. Two plugins only
+    // reading the same attribute do not depend on each other.
+    auto writes = [&contains](const std::vector<std::string>& inputs, const std::vector<std::string>& outputs) {
+        std::vector<std::string> written;
+        std::copy_if(outputs.begin(), outputs.end(), std::back_inserter(written),
+                     [&](const std::string& attribute) { return !contains(inputs, attribute); });
+        return written;
+    };
+    std::vector<std::string> laterWrites = writes(laterInputs, laterOutputs);
+    std::vector<std::string> earlierWrites = writes(earlierInputs, earlierOutputs);
+    auto overlaps = [&contains](const std::vector<std::string>& a, const std::vector<std::string>& b) {
+        return std::any_of(a.begin(), a.end(), [&](const std::string& attribute) { return contains(b, attribute); });
+    };
+    // Reading what the earlier plugin writes, writing what it reads, or both writing the same attribute.
+    return overlaps(laterInputs, earlierWrites) || overlaps(laterWrites, earlierInputs) || overlaps(laterWrites, earlierWrites);
+}
+
+void DagPluginExecutor::buildGraph() {
+    graph_.clear();
+    for (auto a : managedPlugins_) {
+        if (a.second) graph_.push_back({a.first, a.second, {}, {}});
+    }
+    for (size_t later = 0; later < graph_.size(); ++later) {
+        for (size_t earlier = 0; earlier < later; ++earlier) {
+            if (dependsOn(*graph_[later].plugin, *graph_[earlier].plugin)) {
+                graph_[later].dependencies.push_back(earlier);
+                graph_[earlier].dependents.push_back(later);
+            }
+        }
+    }
+}
+
+bool DagPluginExecutor::runNode(Node& node, EmailListView* emailList, std::mutex& listMutex) {
+    // Plugins running side by side each get their own view of the list, so their insert queues never mix.
+    size_t baseRows;
+    EmailListView slice = [&] {
+        std::lock_guard lock(listMutex);
+        baseRows = emailList->getRowCount();
+        return emailList->slice(0, baseRows, emailList->getRangeOffsets());
+    }();
+
+    bool status = node.plugin->execute(&slice);
+
+    // Committed while holding the list, so plugins depending on this one see its inserts when they start.
+    // A plugin narrowing its slice narrows the list, which barriers (filters declare no attributes) do alone.
+    std::lock_guard lock(listMutex);
+    emailList->absorbSlice(slice, baseRows);
+    emailList->commitInserts();
+    return status;
+}
+
+bool DagPluginExecutor::execute(EmailListView * emailList) {
+    LOG_INFO << "DagPluginExecutor::execute called.";
+
+    if (!emailList || managedPlugins_.empty()) {
+        LOG_ERROR << "EmailList is null or no plugins are registered.";
+        return false;
+    }
+    SET_PLUGIN_STATE("RUNNING");
+    buildGraph(); // Plugins may have been removed or reconfigured since instantiation.
+
+    std::vector<std::atomic<size_t>> waiting(graph_.size());
+    for (size_t i = 0; i < graph_.size(); ++i) {
+        waiting[i].store(graph_[i].dependencies.size());
+    }
+    std::atomic<bool> failed = false;
+    std::mutex listMutex;
+
+    TaskGroup group(*WorkStealingPool::getInstance());
+    std::function<void(size_t)> runReady = [&](size_t index) {
+        Node& node = graph_[index];
+        if (!failed.load()) {
+            try {
+                if (!runNode(node, emailList, listMutex)) {
+                    LOG_ERROR << "DAG plugin " << node.instanceID << " failed.";
+                    failed.store(true);
+                }
+            } catch (const std::exception& e) {
+                LOG_ERROR << "DAG plugin " << node.instanceID << " threw: " << e.what();
+                failed.store(true);
+            }
+        }
+        // Dependents are released even after a failure, so they drain (skipped) and the wait returns.
+        for (size_t dependent : node.dependents) {
+            if (waiting[dependent].fetch_sub(1) == 1) {
+                group.run([&runReady, dependent] { runReady(dependent); });
+            }
+        }
+    };
+    size_t roots = 0;
+    for (size_t i = 0; i < graph_.size(); ++i) {
+        if (graph_[i].dependencies.empty()) {
+            group.run([&runReady, i] { runReady(i); });
+            ++roots;
+        }
+    }
+    try {
+        group.wait();
+    } catch (const std::exception& e) {
+        LOG_ERROR << "DAG plugin task threw: " << e.what();
+        failed.store(true);
+    }
+
+    LOG_DEBUG_VERBOSE << "DagPluginExecutor ran " << graph_.size() << " plugins from " << roots << " independent starting points.";
+    bool status = !failed.load();
+    status ? SET_PLUGIN_STATE("COMPLETE") : SET_PLUGIN_STATE("FAILED");
+    return status;
+}
+
+bool DagPluginExecutor::executeOne(EmailListView * emailList, std::string instanceID) {
+    LOG_INFO << "DagPluginExecutor::executeOne called.";
+
+    if (!emailList || managedPlugins_.empty()) {
+        LOG_ERROR << "EmailList is null or no plugins are registered.";
+        return false;
+    }
+    buildGraph();
+    auto node = std::find_if(graph_.begin(), graph_.end(), [&instanceID](const Node& n) { return n.instanceID == instanceID; });
+    if (node == graph_.end()) {
+        LOG_ERROR << "DAG Plugin being asked for doesn't exist!";
+        return false;
+    }
+    // Only the plugins it depends on have to be complete, not every plugin configured before it.
+    for (size_t dependency : node->dependencies) {
+        if (graph_[dependency].plugin->getState() != "COMPLETE") {
+            LOG_DEBUG_VERBOSE << "DAG dependency:" << graph_[dependency].instanceID << " is not complete before asking to execute: " << instanceID << ".";
+            SET_PLUGIN_STATE("READY");
+            return true;
+        }
+    }
+    SET_PLUGIN_STATE("RUNNING");
+    bool status = node->plugin->execute(emailList);
+    emailList->commitInserts();
+    SET_PLUGIN_STATE("READY");
+    return status;
+}
+
+void DagPluginExecutor::clearAllInstances() {
+    for (auto a : managedPlugins_) {
+        auto* executor = dynamic_cast<PluginExecutorInterface*>(a.second.get());
+        if (executor) {
+            executor->clearAllInstances();
+        }
+    }
+    graph_.clear();
+    managedPlugins_.clear();
+}
+
+nlohmann::json DagPluginExecutor::printRecursiveInstanceTreeJson() {
+    nlohmann::json node;
+    try {
+        node["instanceID"] = instanceID_;
+        node["createFunc"] = Plugins->getCreateFuncForInstance(instanceID_);
+        node["state"]     = getState();
+        node["schema"]      = optionSchema_;
+        node["config"]         = optionConfig_;
+        node["children"] = nlohmann::json::array();
+        for (auto a : managedPlugins_) {
+            if (a.second) node["children"].emplace_back(a.second->printRecursiveInstanceTreeJson());
+        }
+    } catch (std::exception& e) {
+        LOG_ERROR << e.what();
+    }
+    return node;
+}
+
+std::shared_ptr<PluginInterface> DagPluginExecutor::getInstantiatedPluginByID(const std::string& pluginInstanceID) {
+    return managedPlugins_[pluginInstanceID];
+}
+
+// Update a plugin's configuration
+void DagPluginExecutor::updateInstantiatedPluginConfig(const std::string& pluginInstanceID, const nlohmann::json& newOptions) {
+    if (std::shared_ptr<PluginInterface> plugin = getInstantiatedPluginByID(pluginInstanceID)) {
+        plugin->setConfig(newOptions);
+        LOG_DEBUG_VERBOSE << "Updated config for plugin: " << pluginInstanceID;
+    }
+}
+
+// Remove a plugin instance
+void DagPluginExecutor::removeInstantiatedPlugin(const std::string& pluginInstanceID) {
+    managedPlugins_.erase(pluginInstanceID);
+}
+
+std::string DagPluginExecutor::getInstantiatedPluginConfig(const std::string& pluginInstanceID) {
+    return managedPlugins_[pluginInstanceID]->getConfig();
+}
+
+std::string DagPluginExecutor::getInstantiatedPluginStatus(const std::string &pluginInstanceID) {
+    if (!managedPlugins_[pluginInstanceID]) return "";
+    return managedPlugins_[pluginInstanceID]->getState();
+}
+
+std::vector<std::string> DagPluginExecutor::listPluginsByID() {
+    std::vector<std::string> instanceIDs;
+    for (const auto& [instanceID, _] : managedPlugins_) {
+        instanceIDs.push_back(instanceID);
+    }
+    return instanceIDs;
+}
+
+bool DagPluginExecutor::reloadPluginsFromConfig() {
+    if (!validateConfig()) { // Checking my schema is valid before continuing...
+        LOG_ERROR << "Schema invalid for " << getPluginName();
+        return false;
+    }
+
+    for (const auto& pluginData : optionConfig_["plugins"]) {
+        std::string pluginName = pluginData["name"];
+        nlohmann::json options = pluginData.value("options", nlohmann::json{});
+
+        if (auto pluginInstance = Plugins->createPluginInstance(pluginName, options)) {
+            managedPlugins_[pluginInstance->first] = std::move(pluginInstance->second);
+        } else {
+            LOG_ERROR << "Failed to load plugin: " << pluginName;
+            SET_PLUGIN_STATE("FAILED");
+            return false;
+        }
+    }
+    return true;
+}
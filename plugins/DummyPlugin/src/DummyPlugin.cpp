@@ -57,7 +57,7 @@ DummyPlugin::~DummyPlugin() = default;
 bool DummyPlugin::execute(EmailListView * emailList) {
     LOG_INFO << "DummyPlugin::execute called.";
     SET_PLUGIN_STATE("RUNNING");
-    for (auto email : *emailList) {
+    for (const auto& email : *emailList) {
         LOG_DEBUG_VERBOSE << "Email " << email.getUniqueHash() << " Parsed by DummyPlugin";
     }
     SET_PLUGIN_STATE("COMPLETE");
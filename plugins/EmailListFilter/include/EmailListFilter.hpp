@@ -1,5 +1,6 @@
 #pragma once
 #include "PluginRunnableInterface.hpp"
+#include <regex>
 
 class Email;
 
@@ -21,8 +22,9 @@ private:
         std::string outcome;
         std::string filterBy;
         std::vector<std::string> values;
+        std::vector<std::regex> patterns; // Compiled from values when filtering by regex.
     };
-    void processEmail(const Email& email, EmailListView* emailList, const filterStruct& emailFilter) const;
+    bool processEmail(const filterStruct& emailFilter) const;
 
     struct Register {
         Register() {
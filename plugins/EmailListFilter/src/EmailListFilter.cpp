@@ -10,6 +10,8 @@
 #include "Email.hpp"
 #include <vector>
 #include <filesystem>
+#include <algorithm>
+#include <iterator>
 
 EmailListFilter::EmailListFilter(const std::string& instanceID) : PluginRunnableInterface(instanceID) {
     pluginName_ = "EmailListFilter";
@@ -19,6 +21,12 @@ EmailListFilter::EmailListFilter(const std::string& instanceID) : PluginRunnable
     "$schema": "https://json-schema.org/draft/2020-12/schema",
     "type": "object",
     "properties": {
+      "mode": {
+        "type": "string",
+        "enum": ["remove", "select"],
+        "default": "remove",
+        "description": "remove deletes rejected emails from storage, select only narrows the email list seen by the plugins that follow."
+      },
       "filters": {
         "type": "array",
         "items": {
@@ -109,35 +117,71 @@ nlohmann::json EmailListFilter::printRecursiveInstanceTreeJson() {
     return node;
 }
 
-// Helper function to process a single email
-void EmailListFilter::processEmail(const Email& email, EmailListView* emailList, const filterStruct& emailFilter) const {
+// Helper function to process a single email, returns true if the filter removes it
+bool EmailListFilter::processEmail(const filterStruct& emailFilter) const {
     bool matchFound = false;
-    for (const auto& filterValue : emailFilter.values) {
+    auto fieldIt = filters.find(emailFilter.field);
+    if (fieldIt != filters.end()) {
+        const std::vector<std::string>& fieldValues = fieldIt->second;
         if (emailFilter.filterBy == "string") {
-            if (std::ranges::find(filters.at(emailFilter.field), filterValue) != filters.at(emailFilter.field).end()) {
-                matchFound = true;
+            for (const auto& filterValue : emailFilter.values) {
+                if (std::ranges::find(fieldValues, filterValue) != fieldValues.end()) {
+                    matchFound = true;
+                    break;
+                }
             }
         } else {
-            std::regex re(filterValue);
-            const auto it = std::ranges::find_if(filters.at(emailFilter.field), [&](const auto& e) { return std::regex_match(e, re); });
-            if (it != filters.at(emailFilter.field).end()) {
-                matchFound = true;
+            for (const std::regex& re : emailFilter.patterns) {
+                if (std::ranges::any_of(fieldValues, [&](const auto& e) { return std::regex_match(e, re); })) {
+                    matchFound = true;
+                    break;
+                }
             }
         }
     }
-    // Remove email based on the outcome and whether a match was found
-    if ((emailFilter.outcome == "include" && !matchFound) ||
-        (emailFilter.outcome == "exclude" && matchFound)) {
-        //emailList->removeEmail(email);
-    }
+    return (emailFilter.outcome == "include" && !matchFound) ||
+           (emailFilter.outcome == "exclude" && matchFound);
 }
 
 // Main execution logic
 bool EmailListFilter::execute(EmailListView* emailList) {
     LOG_INFO << "EmailListFilter::execute called.";
     SET_PLUGIN_STATE("RUNNING");
+
+    // Parse the configuration (and compile any regexes) once, rather than for every email.
+    std::vector<filterStruct> parsedFilters;
+    try {
+        for (const auto& filter : optionConfig_["filters"]) {
+            for (const auto& field : filter["fields"]) {
+                filterStruct filtering;
+                filtering.field = field["value"].get<std::string>();
+                filtering.outcome = field["outcome"].get<std::string>();
+                filtering.filterBy = field["filterBy"].get<std::string>();
+                for (const auto& vals : field["filterVals"]) {
+                    filtering.values.push_back(vals["filterValue"].get<std::string>());
+                }
+                if (filtering.filterBy != "string") {
+                    for (const auto& value : filtering.values) {
+                        filtering.patterns.emplace_back(value);
+                    }
+                }
+                parsedFilters.push_back(std::move(filtering));
+            }
+        }
+    } catch (const std::exception& e) {
+        LOG_ERROR << "EmailListFilter configuration is invalid: " << e.what();
+        SET_PLUGIN_STATE("FAILED");
+        return false;
+    }
+
+    bool selectOnly = optionConfig_.value("mode", "remove") == "select";
+    EmailRowSelection selection;
+
+    // Single pass: removal only tombstones the email, so the iteration is never disturbed.
+    size_t removed = 0;
     for (auto it = emailList->begin(); it != emailList->end(); ++it) {
         Email& email = *it;
+        filters.clear();
         filters["headerKey"] = email.getHeaderKeys();
         filters["headerVal"] = email.getHeaderValues();
         filters["attributeKey"] = email.getAttributeKeys();
@@ -147,34 +191,39 @@ bool EmailListFilter::execute(EmailListView* emailList) {
         }
         filters["attributeVal"] = values;
         std::vector<std::string> bodys;
-        EmailBody* body = email.getBody();
-        if (StandardEmailBody* standardBody = dynamic_cast<StandardEmailBody*>(body)) {
+        std::shared_ptr<EmailBody> body = email.getBody();
+        if (StandardEmailBody* standardBody = dynamic_cast<StandardEmailBody*>(body.get())) {
             bodys.push_back(standardBody->getAllBodyData());
             filters["body"] = bodys;
-        } else if (const MIMEMultipartBodies* mimeBody = dynamic_cast<const MIMEMultipartBodies*>(body)) {
+        } else if (const MIMEMultipartBodies* mimeBody = dynamic_cast<const MIMEMultipartBodies*>(body.get())) {
+            // Every part's headers are matched, as PostgresqlReader's pushdown does.
+            std::vector<std::string>& partKeys = filters["MIMEPartKey"];
+            std::vector<std::string>& partValues = filters["MIMEPartVal"];
             for (const MIMEMultipartPart& multipart : mimeBody->getMultipartParts()) {
                 bodys.push_back(multipart.getBody());
-                filters["MIMEPartKey"] = multipart.getHeaderKeys();
-                filters["MIMEPartVal"] = multipart.getHeaderValues();
+                std::ranges::move(multipart.getHeaderKeys(), std::back_inserter(partKeys));
+                std::ranges::move(multipart.getHeaderValues(), std::back_inserter(partValues));
             }
             filters["body"] = bodys;
 
         }
-        for (const auto& filter : optionConfig_["filters"]) {
-            for (const auto& field : filter["fields"]) {
-                filterStruct filtering;
-                filtering.field = field["value"].get<std::string>();
-                filtering.outcome = field["outcome"].get<std::string>();
-                filtering.filterBy = field["filterBy"].get<std::string>();
-                std::vector<std::string> filterValues;
-                for (const auto& vals : field["filterVals"]) {
-                    filterValues.push_back(vals["filterValue"].get<std::string>());
-                }
-                filtering.values = filterValues;
-                processEmail(email, emailList, filtering);
-            }
+        bool rejected = std::ranges::any_of(parsedFilters, [this](const filterStruct& filtering) {
+            return processEmail(filtering);
+        });
+        if (!rejected) {
+            if (selectOnly) EmailListView::appendRow(selection, it.shard(), it.row());
+        } else if (selectOnly) {
+            ++removed;
+        } else if (emailList->removeEmail(it)) {
+            ++removed;
         }
     }
+    if (selectOnly) {
+        emailList->narrowTo(std::move(selection));
+        LOG_INFO << "EmailListFilter deselected " << removed << " emails.";
+    } else {
+        LOG_INFO << "EmailListFilter removed " << removed << " emails.";
+    }
     SET_PLUGIN_STATE("COMPLETE");
     return true;
-}
\ No newline at end of file
+}
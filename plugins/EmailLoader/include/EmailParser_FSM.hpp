@@ -8,6 +8,7 @@
 #include <unordered_map>
 #include <vector>
 #include "AttributeBagValueInterface.hpp"
+#include "BlobStore.hpp"
 #include "Email.hpp"
 #include "EmailBody.hpp"
 #include "EmailListView.hpp"
@@ -21,8 +22,8 @@ class EmailParser_FSM {
 public:
     using StateHandler = std::function<int(const std::string&)>;
 
-    // Constructor
-    EmailParser_FSM(EmailListView* newEmailList);
+    // Constructor. If mapFileBytes is set, raw files are mmap'd into the BlobStore instead of copied.
+    EmailParser_FSM(EmailListView* newEmailList, bool mapFileBytes = false);
 
     // Recursively parse a directory of emails or a single email
     void parse(std::filesystem::path& p);
@@ -41,6 +42,7 @@ private:
     Email emailObj;
     std::unique_ptr<EmailBody> emailBodyObj;
     EmailListView* emailList;
+    bool mapFileBytes;
     fasttext::FastText fasttext;
 
 
@@ -67,9 +69,8 @@ private:
     int handleMIMEMultiPartBody(const std::string& input);
 
     // Detecting and converting encoding
-    std::vector<char> readFileAsBytes(const std::string& filePath);
-    std::string detectFileEncoding(const std::vector<char>& buffer);
-    std::string convertToUTF8(const std::vector<char>& inputBuffer, const std::string& encoding);
+    std::string detectFileEncoding(std::string_view buffer);
+    std::string convertToUTF8(std::string_view inputBuffer, const std::string& encoding);
     void detectLanguage(const std::string& text);
     std::string getLanguageName(const std::string& isoCode, const std::string& displayLocale = "en");
 
@@ -26,6 +26,10 @@ EmailLoader::EmailLoader(const std::string& instanceID) :
         "emailPath": {
           "type": "string",
           "description": "Path to an email file or a directory. If a directory, it will be traversed recursively."
+        },
+        "mapFileBytes": {
+          "type": "boolean",
+          "description": "If true, raw email files are memory-mapped into the blob store rather than copied onto the heap."
         }
       },
       "required": ["emailPath"],
@@ -63,9 +67,10 @@ bool EmailLoader::execute(EmailListView * emailList) {
     LOG_INFO << "EmailLoader::execute called.";
     SET_PLUGIN_STATE("RUNNING");
     try {
-        EmailParser_FSM fsm(emailList);
+        EmailParser_FSM fsm(emailList, optionConfig_.value("mapFileBytes", false));
         std::filesystem::path p = optionConfig_["emailPath"];
         fsm.parse(p);
+        emailList->commitInserts();
     } catch (std::exception& e) {
         SET_PLUGIN_STATE("FAILED");
         LOG_ERROR << e.what();
@@ -7,7 +7,7 @@ const std::regex multipartRegex(R"(\s*multipart/.*?boundary=\"?([^\";\s]+)\"?)")
 const std::regex mimeheaderkeyRegex(R"(^([\w-]+): (.*))");
 
 using StateHandler = std::function<int(const std::string&)>;
-EmailParser_FSM::EmailParser_FSM(EmailListView* newEmailList) : currentState(ReadingState::NotReading) {
+EmailParser_FSM::EmailParser_FSM(EmailListView* newEmailList, bool newMapFileBytes) : mapFileBytes(newMapFileBytes), currentState(ReadingState::NotReading) {
     // resetMemberVars();
     // Initialize state handlers
     stateHandlers[ReadingState::NotReading] = [this](const std::string& input) -> int {return handleNotReading(input);};
@@ -64,11 +64,11 @@ void EmailParser_FSM::processLine(const std::string& line) {
 
 void EmailParser_FSM::readEmail(const std::string& filePath) { // throws std::exception();
     try {
-        std::vector<char> fileBytes = readFileAsBytes(filePath);
-        emailObj.insertAttribute("File bytes", std::make_unique<AttributeBagCharVector>(AttributeBagCharVector(fileBytes)));
-        std::string encoding = detectFileEncoding(fileBytes);
+        BlobHandle fileBytes = BlobStore::getInstance()->internFile(filePath, mapFileBytes);
+        emailObj.insertAttribute("File bytes", std::make_unique<AttributeBagBlob>(fileBytes));
+        std::string encoding = detectFileEncoding(fileBytes->view());
         if (encoding != "UNKNOWN"){
-            std::string utf8Text = convertToUTF8(fileBytes, encoding);
+            std::string utf8Text = convertToUTF8(fileBytes->view(), encoding);
             std::istringstream iss(utf8Text);
             detectLanguage(utf8Text);
             for (std::string line; std::getline(iss, line);) {
@@ -146,18 +146,7 @@ void EmailParser_FSM::detectLanguage(const std::string& text) {
     emailObj.insertAttribute("Language predictions", std::make_unique<AttributeBagStringFloatPairVector>(AttributeBagStringFloatPairVector(languages)));
 }
 
-std::vector<char> EmailParser_FSM::readFileAsBytes(const std::string &filePath) {
-    std::ifstream file(filePath, std::ios::binary);
-    if (!file) {
-        throw std::runtime_error("Error: Unable to open file: " + filePath);
-    }
-
-    // Read file into a byte vector
-    return std::vector<char>((std::istreambuf_iterator<char>(file)),
-                              std::istreambuf_iterator<char>());
-}
-
-std::string EmailParser_FSM::detectFileEncoding(const std::vector<char> &buffer) {
+std::string EmailParser_FSM::detectFileEncoding(std::string_view buffer) {
     UErrorCode status = U_ZERO_ERROR;
     UCharsetDetector* detector = ucsdet_open(&status);
     if (U_FAILURE(status)) {
@@ -187,7 +176,7 @@ std::string EmailParser_FSM::detectFileEncoding(const std::vector<char> &buffer)
     return encoding ? encoding : "UNKNOWN";
 }
 
-std::string EmailParser_FSM::convertToUTF8(const std::vector<char>& inputBuffer, const std::string& encoding) {
+std::string EmailParser_FSM::convertToUTF8(std::string_view inputBuffer, const std::string& encoding) {
     UErrorCode status = U_ZERO_ERROR;
 
     // Open ICU converter for the detected encoding
@@ -387,7 +376,7 @@ void EmailParser_FSM::flush() {
         }
         if (isUnique) {
             //LOG_DEBUG_VERBOSE << "Email doesn't exist: " << emailObj.getUniqueHash();
-            emailList->insertEmail(emailObj);
+            emailList->insertEmail(std::move(emailObj)); // resetMemberVars() starts a fresh emailObj below.
             //LOG_DEBUG_VERBOSE << "Inserting Email: " << emailObj.getUniqueHash();
         }
         resetMemberVars();
@@ -0,0 +1,26 @@
+#pragma once
+#include "PluginRunnableInterface.hpp"
+
+// EmailSnapshotLoader class implementing PluginInterface
+class EmailSnapshotLoader final : public PluginRunnableInterface {
+public:
+    EmailSnapshotLoader(const std::string&);  // Constructor
+    ~EmailSnapshotLoader() override;  // Destructor
+
+    bool instantiateRecursive() override;
+    nlohmann::json printRecursiveInstanceTreeJson() override;
+
+    bool execute(EmailListView * emailList) override;
+
+private:
+    struct Register {
+        Register() {
+            std::string name = "EmailSnapshotLoader";
+            LOG_DEBUG_VERBOSE << "Registering plugin " << name;
+            Plugins->registerPlugin(name, [](const std::string& instanceID) -> PluginInterface* {
+                return new EmailSnapshotLoader(instanceID);
+            });
+        }
+    };
+    static inline Register reg;
+};
@@ -0,0 +1,62 @@
+#include "EmailSnapshotLoader.hpp"
+#include <filesystem>
+#include "EmailListView.hpp"
+#include "EmailSegmentFile.hpp"
+#include "Logger.hpp"
+
+EmailSnapshotLoader::EmailSnapshotLoader(const std::string& instanceID) : PluginRunnableInterface(instanceID) {
+    pluginName_ = "EmailSnapshotLoader";
+    instanceID_ = instanceID;
+    optionSchema_ = R"(
+{
+  "$schema": "https://json-schema.org/draft/2020-12/schema",
+  "type": "object",
+  "properties": {
+    "snapshotPath": {
+      "type": "string",
+      "description": "File written by EmailSnapshotWriter to load the emails from."
+    }
+  },
+  "required": ["snapshotPath"],
+  "additionalProperties": false
+}
+    )"_json;
+    inputAttributes_ = {};
+    generatedAttributes_ = {};
+    SET_PLUGIN_STATE("LOADED");
+}
+
+EmailSnapshotLoader::~EmailSnapshotLoader() = default;
+
+bool EmailSnapshotLoader::instantiateRecursive() {
+    SET_PLUGIN_STATE("READY");
+    return true;
+}
+
+nlohmann::json EmailSnapshotLoader::printRecursiveInstanceTreeJson() {
+    nlohmann::json node;
+    try {
+        node["instanceID"] = instanceID_;
+        node["createFunc"] = Plugins->getCreateFuncForInstance(instanceID_) ? Plugins->getCreateFuncForInstance(instanceID_) : "Not Loaded";
+        node["state"]     = getState();
+        node["schema"]       = !optionSchema_.empty()? optionSchema_ : "";
+        node["config"]       = !optionConfig_.empty() ? optionConfig_ : "";
+    } catch (std::exception& e) {
+        LOG_ERROR << e.what();
+    }
+    return node;
+}
+
+bool EmailSnapshotLoader::execute(EmailListView * emailList) {
+    SET_PLUGIN_STATE("RUNNING");
+    std::filesystem::path path = optionConfig_["snapshotPath"].get<std::string>();
+    std::optional<size_t> loaded = EmailSegmentFile::load(path, *emailList);
+    if (!loaded) {
+        SET_PLUGIN_STATE("FAILED");
+        return false;
+    }
+    emailList->commitInserts();
+    LOG_INFO << "EmailSnapshotLoader loaded " << *loaded << " emails from " << path.string() << ".";
+    SET_PLUGIN_STATE("COMPLETE");
+    return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "PluginRunnableInterface.hpp"
+
+// EmailSnapshotWriter class implementing PluginInterface
+class EmailSnapshotWriter final : public PluginRunnableInterface {
+public:
+    EmailSnapshotWriter(const std::string&);  // Constructor
+    ~EmailSnapshotWriter() override;  // Destructor
+
+    bool instantiateRecursive() override;
+    nlohmann::json printRecursiveInstanceTreeJson() override;
+
+    bool execute(EmailListView * emailList) override;
+
+private:
+    struct Register {
+        Register() {
+            std::string name = "EmailSnapshotWriter";
+            LOG_DEBUG_VERBOSE << "Registering plugin " << name;
+            Plugins->registerPlugin(name, [](const std::string& instanceID) -> PluginInterface* {
+                return new EmailSnapshotWriter(instanceID);
+            });
+        }
+    };
+    static inline Register reg;
+};
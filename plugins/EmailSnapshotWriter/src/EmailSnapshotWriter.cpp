@@ -0,0 +1,61 @@
+#include "EmailSnapshotWriter.hpp"
+#include <filesystem>
+#include "EmailListView.hpp"
+#include "EmailSegmentFile.hpp"
+#include "Logger.hpp"
+
+EmailSnapshotWriter::EmailSnapshotWriter(const std::string& instanceID) : PluginRunnableInterface(instanceID) {
+    pluginName_ = "EmailSnapshotWriter";
+    instanceID_ = instanceID;
+    optionSchema_ = R"(
+{
+  "$schema": "https://json-schema.org/draft/2020-12/schema",
+  "type": "object",
+  "properties": {
+    "snapshotPath": {
+      "type": "string",
+      "description": "File to write the emails to. An existing file is replaced once the new one is complete."
+    }
+  },
+  "required": ["snapshotPath"],
+  "additionalProperties": false
+}
+    )"_json;
+    inputAttributes_ = {};
+    generatedAttributes_ = {};
+    SET_PLUGIN_STATE("LOADED");
+}
+
+EmailSnapshotWriter::~EmailSnapshotWriter() = default;
+
+bool EmailSnapshotWriter::instantiateRecursive() {
+    SET_PLUGIN_STATE("READY");
+    return true;
+}
+
+nlohmann::json EmailSnapshotWriter::printRecursiveInstanceTreeJson() {
+    nlohmann::json node;
+    try {
+        node["instanceID"] = instanceID_;
+        node["createFunc"] = Plugins->getCreateFuncForInstance(instanceID_) ? Plugins->getCreateFuncForInstance(instanceID_) : "Not Loaded";
+        node["state"]     = getState();
+        node["schema"]       = !optionSchema_.empty()? optionSchema_ : "";
+        node["config"]       = !optionConfig_.empty() ? optionConfig_ : "";
+    } catch (std::exception& e) {
+        LOG_ERROR << e.what();
+    }
+    return node;
+}
+
+bool EmailSnapshotWriter::execute(EmailListView * emailList) {
+    SET_PLUGIN_STATE("RUNNING");
+    std::filesystem::path path = optionConfig_["snapshotPath"].get<std::string>();
+    std::optional<size_t> written = EmailSegmentFile::write(path, *emailList);
+    if (!written) {
+        SET_PLUGIN_STATE("FAILED");
+        return false;
+    }
+    LOG_INFO << "EmailSnapshotWriter wrote " << *written << " emails to " << path.string() << ".";
+    SET_PLUGIN_STATE("COMPLETE");
+    return true;
+}
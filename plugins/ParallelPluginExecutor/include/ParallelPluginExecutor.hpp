@@ -1,6 +1,11 @@
 #pragma once
+#include <map>
+#include <mutex>
+#include "EmailListView.hpp"
+#include "OrderedStringToPluginInterfaceMap.hpp"
 #include "PluginExecutorInterface.hpp"
 #include "PluginRegistry.hpp"
+#include "WorkStealingPool.hpp"
 
 class ParallelPluginExecutor final : public PluginExecutorInterface {
 public:
@@ -29,6 +34,35 @@ public:
     bool executeOne(EmailListView *, std::string) override;
 
 private:
+    static constexpr size_t INITIAL_CHUNK_SIZE = 16;  // Used until a chunk has been timed.
+    static constexpr size_t MAX_CHUNK_SIZE = 4096;
+
+    // Shared progress of one execute() call: chunks are claimed from it and report their cost to it.
+    struct ChunkCursor {
+        size_t totalRows = 0;
+        size_t chains = 1;
+        uint64_t targetNanos = 0;
+        std::atomic<size_t> next = 0;
+        std::atomic<uint64_t> emailsDone = 0;
+        std::atomic<uint64_t> nanosDone = 0;
+        std::atomic<bool> failed = false;
+        // What each chunk ended up covering, by offset, so a plugin narrowing its chunk can narrow the list.
+        std::mutex chunkMutex;
+        std::map<size_t, std::pair<size_t, EmailRowSelection>> chunkSelections;
+        std::atomic<bool> narrowed = false;
+
+        size_t nextChunkSize() const;
+    };
+
+    // Claims chunks from the cursor until it is exhausted, running one chain's own plugin instances over each.
+    bool runChain(EmailListView* emailList, const std::vector<size_t>& rangeOffsets, ChunkCursor& cursor,
+                  const std::vector<std::shared_ptr<PluginInterface>>& plugins);
+
+    // Builds one set of plugin instances per chain. Set 0 is managedPlugins_ itself, the rest are clones.
+    bool buildWorkerPlugins(size_t chains);
+    size_t getChainCount() const;
+    std::string getMergedState(const std::string& pluginInstanceID);
+
     struct Register {
         Register() {
             std::string name = "ParallelPluginExecutor";
@@ -39,6 +73,8 @@ private:
         }
     };
 
-    std::unordered_map<std::string, std::shared_ptr<PluginInterface>> managedPlugins_;
+    OrderedStringToPluginInterfaceMap managedPlugins_ = {}; // Ordered list of plugins
+    // Per chain, the instances it executes, in managedPlugins_ order. Thread-safe plugins are shared by every chain.
+    std::vector<std::vector<std::shared_ptr<PluginInterface>>> workerPlugins_;
     static inline Register reg;
 };
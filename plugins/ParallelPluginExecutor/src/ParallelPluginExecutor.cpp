@@ -1,4 +1,6 @@
-#include <future>
+#include <algorithm>
+#include <chrono>
+#include <set>
 
 #include "ParallelPluginExecutor.hpp"
 #include "Logger.hpp"
@@ -16,7 +18,7 @@ ParallelPluginExecutor::ParallelPluginExecutor(const std::string& instanceID) :
     "$schema": "https://json-schema.org/draft/2020-12/schema",
     "type": "object",
     "properties": {
-        "plugin": {
+        "plugins": {
             "type": "array",
             "description": "List of plugins to be executed by this executor.",
             "items": {
@@ -41,12 +43,16 @@ ParallelPluginExecutor::ParallelPluginExecutor(const std::string& instanceID) :
         },
           "num_threads": {
             "type":"integer",
-              "description": "Number of threads to evenly distribute the input EmailList accross."
+              "description": "Maximum number of chunks of the input EmailList processed at once. Defaults to every worker of the shared pool (worker_threads in the global config). Plugins that are not thread-safe are cloned once per chunk processed at once."
+          },
+          "chunk_target_ms": {
+            "type": "number",
+            "default": 5,
+            "description": "Target processing time per chunk. Chunk sizes adapt to the observed cost per email to meet it."
           }
     },
     "required": [
-        "plugin",
-      "num_threads"
+        "plugins"
     ],
     "additionalProperties": true
 }
@@ -55,47 +61,167 @@ ParallelPluginExecutor::ParallelPluginExecutor(const std::string& instanceID) :
 }
 
 bool ParallelPluginExecutor::instantiateRecursive() {
-    bool status = true;
-    reloadPluginsFromConfig();
+    bool status = reloadPluginsFromConfig();
     for (auto plugin : managedPlugins_) {
         status &= plugin.second->instantiateRecursive();
     }
+    status &= buildWorkerPlugins(getChainCount()); // Cloned up front, as the registry is not safe to use from workers.
     status? SET_PLUGIN_STATE("READY") : SET_PLUGIN_STATE("FAILED");
     return status;
 }
 
+size_t ParallelPluginExecutor::getChainCount() const {
+    size_t workers = WorkStealingPool::getInstance()->getWorkerCount();
+    int numThreads = optionConfig_.value("num_threads", 0);
+    return (numThreads > 0) ? std::min<size_t>(numThreads, workers) : workers;
+}
+
+bool ParallelPluginExecutor::buildWorkerPlugins(size_t chains) {
+    workerPlugins_.assign(1, {});
+    for (auto a : managedPlugins_) {
+        if (a.second) workerPlugins_[0].push_back(a.second);
+    }
+
+    for (size_t chain = 1; chain < chains; ++chain) {
+        std::vector<std::shared_ptr<PluginInterface>> instances;
+        for (const auto& prototype : workerPlugins_[0]) {
+            if (prototype->isThreadSafe()) {
+                instances.push_back(prototype);
+                continue;
+            }
+            // A fresh instance from the prototype's config, so no mutable member is ever shared between chains.
+            std::optional<std::string> pluginName = Plugins->getCreateFuncForInstance(prototype->getInstanceID());
+            auto clone = pluginName ? Plugins->createPluginInstance(*pluginName, prototype->getConfig()) : std::nullopt;
+            if (!clone || !clone->second->instantiateRecursive()) {
+                LOG_ERROR << "Failed to clone plugin " << prototype->getInstanceID() << " for chain " << chain << ".";
+                workerPlugins_.resize(1);
+                return false;
+            }
+            instances.push_back(std::move(clone->second));
+        }
+        workerPlugins_.push_back(std::move(instances));
+    }
+    LOG_DEBUG_VERBOSE << getInstanceID() << " prepared " << workerPlugins_.size() << " sets of plugin instances.";
+    return true;
+}
+
+std::string ParallelPluginExecutor::getMergedState(const std::string& pluginInstanceID) {
+    std::shared_ptr<PluginInterface> prototype = managedPlugins_.at(pluginInstanceID);
+    std::set<std::string> states = {prototype->getState()};
+    if (!workerPlugins_.empty()) {
+        auto it = std::find(workerPlugins_[0].begin(), workerPlugins_[0].end(), prototype);
+        if (it != workerPlugins_[0].end()) {
+            size_t index = it - workerPlugins_[0].begin();
+            for (const auto& instances : workerPlugins_) {
+                states.insert(instances[index]->getState());
+            }
+        }
+    }
+    // A single failed clone fails the plugin, and it is still running until every clone has finished.
+    for (const char* state : {"FAILED", "RUNNING", "COMPLETE", "READY", "LOADED", "UNLOADED"}) {
+        if (states.contains(state)) return state;
+    }
+    return prototype->getState();
+}
+
+size_t ParallelPluginExecutor::ChunkCursor::nextChunkSize() const {
+    size_t claimed = std::min(next.load(), totalRows);
+    size_t remaining = totalRows - claimed;
+    // Never hand out more than an even share of what is left, so the tail still spreads across workers.
+    size_t fairShare = std::max<size_t>(1, remaining / (2 * chains));
+
+    uint64_t emails = emailsDone.load();
+    uint64_t elapsed = nanosDone.load();
+    size_t adaptive = (emails > 0 && elapsed > 0)
+        ? static_cast<size_t>(static_cast<double>(targetNanos) * emails / elapsed)
+        : INITIAL_CHUNK_SIZE;
+    return std::clamp<size_t>(adaptive, 1, std::min(fairShare, MAX_CHUNK_SIZE));
+}
+
+bool ParallelPluginExecutor::runChain(EmailListView* emailList, const std::vector<size_t>& rangeOffsets, ChunkCursor& cursor,
+                                      const std::vector<std::shared_ptr<PluginInterface>>& plugins) {
+    while (!cursor.failed.load()) {
+        size_t size = cursor.nextChunkSize();
+        size_t offset = cursor.next.fetch_add(size);
+        if (offset >= cursor.totalRows) break;
+        size = std::min(size, cursor.totalRows - offset);
+
+        auto started = std::chrono::steady_clock::now();
+        EmailListView chunk = emailList->slice(offset, size, rangeOffsets);
+        for (const auto& plugin : plugins) {
+            if (!plugin->execute(&chunk)) {
+                LOG_ERROR << "Plugin execution failed on emails " << offset << " to " << offset + size << ".";
+                cursor.failed.store(true);
+                return false;
+            }
+        }
+        chunk.commitInserts();
+        if (chunk.isNarrowed()) cursor.narrowed.store(true);
+        {
+            std::lock_guard lock(cursor.chunkMutex);
+            cursor.chunkSelections[offset] = {size, chunk.getSelection()};
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started);
+
+        cursor.emailsDone.fetch_add(size);
+        cursor.nanosDone.fetch_add(elapsed.count());
+    }
+    return !cursor.failed.load();
+}
+
 bool ParallelPluginExecutor::execute(EmailListView* emailList) {
     LOG_INFO << "ParallelPluginExecutor::execute called.";
     SET_PLUGIN_STATE("RUNNING");
-    int numThreads = optionConfig_["num_threads"];
-    auto partitions = emailList->split(numThreads);
-
-    std::vector<std::future<bool>> futures;
-    for (auto& partition : partitions) {
-        futures.push_back(std::async(std::launch::async, [this, &partition]() {
-            for (auto& [_, plugin] : managedPlugins_) {
-                if (plugin) {
-                    bool success = plugin->execute(&partition);
-                    if (!success) {
-                        SET_PLUGIN_STATE("FAILED");
-                        LOG_ERROR << "Plugin execution failed.";
-                        return false;
-                    }
-                }
-            }
-            partition.commitInserts();
-            return true;
-        }));
+    // Every executor shares the process-wide pool, so nested parallel executors never oversubscribe cores.
+    WorkStealingPool* pool = WorkStealingPool::getInstance();
+    size_t chains = getChainCount();
+    if (workerPlugins_.size() != chains && !buildWorkerPlugins(chains)) { // Stale after a config change or removal.
+        SET_PLUGIN_STATE("FAILED");
+        return false;
     }
 
+    ChunkCursor cursor;
+    cursor.chains = chains;
+    cursor.totalRows = emailList->getRowCount();
+    cursor.targetNanos = static_cast<uint64_t>(optionConfig_.value("chunk_target_ms", 5.0) * 1e6);
+    const std::vector<size_t> rangeOffsets = emailList->getRangeOffsets();
+
     bool overallSuccess = true;
-    for (auto& f : futures) {
-        overallSuccess &= f.get();  // Wait for all threads to complete
+    TaskGroup group(*pool);
+    // Each chain claims chunks, sized from the cost observed so far, and runs them through its own plugin
+    // instances, so no instance is ever executed by two threads at once. Waiting on the group runs queued
+    // chains too, so a nested executor's worker keeps helping rather than blocking.
+    for (size_t i = 0; i < cursor.chains; ++i) {
+        group.run([this, emailList, &rangeOffsets, &cursor, &plugins = workerPlugins_[i]] {
+            runChain(emailList, rangeOffsets, cursor, plugins);
+        });
+    }
+    try {
+        group.wait();
+    } catch (const std::exception& e) {
+        LOG_ERROR << "Parallel chunk threw: " << e.what();
+        overallSuccess = false;
     }
+    overallSuccess &= !cursor.failed.load();
+    if (overallSuccess && cursor.narrowed.load()) {
+        emailList->narrowToSlices(std::move(cursor.chunkSelections));
+    }
+
+    LOG_DEBUG_VERBOSE << "ParallelPluginExecutor processed " << cursor.emailsDone.load() << " emails in "
+                      << group.getCompletedCount() << " chains.";
     overallSuccess ? SET_PLUGIN_STATE("COMPLETE") : SET_PLUGIN_STATE("FAILED");
     return overallSuccess;
 }
 void ParallelPluginExecutor::clearAllInstances() {
+    for (size_t chain = 1; chain < workerPlugins_.size(); ++chain) { // Clones own their own children.
+        for (const auto& plugin : workerPlugins_[chain]) {
+            auto* executor = dynamic_cast<PluginExecutorInterface*>(plugin.get());
+            if (executor && !plugin->isThreadSafe()) {
+                executor->clearAllInstances();
+            }
+        }
+    }
+    workerPlugins_.clear();
     for (auto a : managedPlugins_) {
         auto* executor = dynamic_cast<PluginExecutorInterface*>(a.second.get());
         if (executor) {
@@ -120,8 +246,7 @@ bool ParallelPluginExecutor::executeOne(EmailListView * emailList, std::string p
 
 
 std::shared_ptr<PluginInterface> ParallelPluginExecutor::getInstantiatedPluginByID(const std::string& pluginInstanceID) {
-    auto it = managedPlugins_.find(pluginInstanceID);
-    return (it != managedPlugins_.end()) ? it->second : nullptr;
+    return managedPlugins_[pluginInstanceID];
 }
 
 std::string ParallelPluginExecutor::getInstantiatedPluginConfig(const std::string& pluginInstanceID) {
@@ -132,6 +257,7 @@ std::string ParallelPluginExecutor::getInstantiatedPluginConfig(const std::strin
 void ParallelPluginExecutor::updateInstantiatedPluginConfig(const std::string& pluginInstanceID, const nlohmann::json& newOptions) {
     if (std::shared_ptr<PluginInterface> plugin = getInstantiatedPluginByID(pluginInstanceID)) {
         plugin->setConfig(newOptions);
+        workerPlugins_.clear(); // Clones are rebuilt from the new config on the next execute.
         LOG_DEBUG_VERBOSE << "Updated config for plugin: " << pluginInstanceID;
     }
 }
@@ -139,11 +265,12 @@ void ParallelPluginExecutor::updateInstantiatedPluginConfig(const std::string& p
 // Remove a plugin instance
 void ParallelPluginExecutor::removeInstantiatedPlugin(const std::string& pluginInstanceID) {
     managedPlugins_.erase(pluginInstanceID);
+    workerPlugins_.clear();
 }
 
 std::string ParallelPluginExecutor::getInstantiatedPluginStatus(const std::string &pluginInstanceID) {
     if (!managedPlugins_[pluginInstanceID]) return "";
-    return managedPlugins_[pluginInstanceID]->getState();
+    return getMergedState(pluginInstanceID);
 }
 
 bool ParallelPluginExecutor::reloadPluginsFromConfig() {
@@ -158,11 +285,12 @@ bool ParallelPluginExecutor::reloadPluginsFromConfig() {
 
         if (auto pluginInstance = Plugins->createPluginInstance(pluginName, options)) {
             //LOG_DEBUG_VERBOSE << "Loaded plugin: " << pluginName;
-            return (managedPlugins_.at(pluginInstance->first) = std::move(pluginInstance->second)).get();
+            managedPlugins_[pluginInstance->first] = std::move(pluginInstance->second);
+        } else {
+            LOG_ERROR << "Failed to load plugin: " << pluginName;
+            SET_PLUGIN_STATE("FAILED");
+            return false;
         }
-        LOG_ERROR << "Failed to load plugin: " << pluginName;
-        SET_PLUGIN_STATE("FAILED");
-        return false;
     }
     return true;
 }
@@ -177,7 +305,10 @@ nlohmann::json ParallelPluginExecutor::printRecursiveInstanceTreeJson() {
         node["config"]         = optionConfig_;
         node["children"] = nlohmann::json::array();
         for (auto a : managedPlugins_) {
-            node["children"].emplace_back(a.second->printRecursiveInstanceTreeJson());
+            if (!a.second) continue;
+            nlohmann::json child = a.second->printRecursiveInstanceTreeJson();
+            child["state"] = getMergedState(a.first); // Reported across every chain's clone.
+            node["children"].emplace_back(std::move(child));
         }
     } catch (std::exception& e) {
         LOG_ERROR << e.what();
@@ -1,7 +1,10 @@
 #pragma once
 #include "PluginRunnableInterface.hpp"
+#include <optional>
 #include <pqxx/pqxx>
 
+class Email;
+
 // PostgresqlReader class implementing PluginInterface
 class PostgresqlReader final : public PluginRunnableInterface {
 public:
@@ -11,8 +14,14 @@ public:
     nlohmann::json printRecursiveInstanceTreeJson() override;
 
     bool execute(EmailListView * emailList) override;
+
+    bool supportsBatchSource() const override { return true; }
+    bool executeAsSource(EmailListView* emailList, const BatchSink& sink) override;
 private:
-    void getEmails(pqxx::result &result, pqxx::work& trans, EmailListView *emailList);
+    std::vector<Email> readSelection(pqxx::transaction_base& trans);
+    std::string buildSelection(pqxx::transaction_base& trans, pqxx::params& values, int datasetid);
+    std::string buildPushdown(const nlohmann::json& field, pqxx::params& values);
+    void selectEmails(pqxx::transaction_base& trans, int datasetid, std::optional<std::pair<int64_t, int64_t>> idRange = std::nullopt, size_t limit = 0);
     /* Self registration for plugin registry
      struct Register {
          Register() {
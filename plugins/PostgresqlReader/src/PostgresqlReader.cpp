@@ -13,6 +13,12 @@
 #include "EmailBody.hpp"
 #include <pqxx/pqxx>
 #include "PluginRegistry.hpp"
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include "EmailRowAssembly.hpp"
+#include "PostgresqlConnectionPool.hpp"
+#include "WorkStealingPool.hpp"
 
 // Constructor
 PostgresqlReader::PostgresqlReader(const std::string& instanceID) : PluginRunnableInterface(instanceID) {
@@ -35,6 +41,18 @@ PostgresqlReader::PostgresqlReader(const std::string& instanceID) : PluginRunnab
         "type": "string",
         "description": "The name of the dataset."
       },
+      "connections": {
+        "type": "integer",
+        "minimum": 1,
+        "default": 1,
+        "description": "Number of emailid ranges read in parallel, each on its own connection."
+      },
+      "batchSize": {
+        "type": "integer",
+        "minimum": 0,
+        "default": 0,
+        "description": "Number of emails read, built and inserted per batch. 0 reads the whole selection at once."
+      },
       "filters": {
         "type": "array",
         "items": {
@@ -61,6 +79,65 @@ PostgresqlReader::PostgresqlReader(const std::string& instanceID) : PluginRunnab
           "additionalProperties": false
         },
         "description": "A list of filters to apply."
+      },
+      "emailFilters": {
+        "type": "array",
+        "items": {
+          "type": "object",
+          "properties": {
+            "fields": {
+              "type": "array",
+              "items": {
+                "type": "object",
+                "properties": {
+                  "value": {
+                    "type": "string",
+                    "enum": ["headerKey", "headerVal", "attributeKey", "attributeVal", "body", "MIMEPartKey", "MIMEPartVal"],
+                    "description": "The field to match."
+                  },
+                  "outcome": {
+                    "type": "string",
+                    "enum": ["include", "exclude"],
+                    "description": "The outcome of the filter (include or exclude)."
+                  },
+                  "filterBy": {
+                    "type": "string",
+                    "enum": ["string", "regex"],
+                    "description": "The method to filter by."
+                  },
+                  "filterVals": {
+                    "type": "array",
+                    "items": {
+                      "type": "object",
+                      "properties": {
+                        "filterValue": {
+                          "type": "string",
+                          "description": "The value to filter by."
+                        }
+                      },
+                      "required": ["filterValue"],
+                      "additionalProperties": false
+                    },
+                    "description": "A list of values to filter by."
+                  }
+                },
+                "required": [
+                    "value",
+                    "outcome",
+                    "filterBy",
+                    "filterVals"
+                ],
+                "additionalProperties": false
+              },
+              "description": "A list of fields to consider for filtering."
+            }
+          },
+          "required": [
+            "fields"
+          ],
+          "additionalProperties": false
+        },
+        "description": "Filters in EmailListFilter's format, evaluated by the database so only matching emails are read."
       }
     },
     "required": [
@@ -99,152 +176,296 @@ nlohmann::json PostgresqlReader::printRecursiveInstanceTreeJson() {
     return node;
 }
 
-void PostgresqlReader::getEmails(pqxx::result &result, pqxx::work& trans, EmailListView *emailList) {
-    for (const auto& emailRow : result) {
-        int emailId = emailRow[0].as<int>();
-        auto fileIdentifier = emailRow[1].as<std::string>();
-        bool isMimeMultipart = emailRow[2].as<bool>();
+using namespace EmailRowAssembly;
 
-        Email newEmail; // Assuming Email constructor takes these parameters
-        newEmail.setIsMIMEMultipart(isMimeMultipart);
+namespace {
+    // convert_from(..., 'UTF-8') only validates, so checking client-side gives the same text without a round trip.
+    bool isValidUtf8(std::string_view text) {
+        size_t i = 0;
+        while (i < text.size()) {
+            auto lead = static_cast<unsigned char>(text[i]);
+            size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+            if (length == 0 || i + length > text.size()) return false;
+            uint32_t codePoint = length == 1 ? lead : lead & (0x7F >> length);
+            for (size_t k = 1; k < length; ++k) {
+                auto continuation = static_cast<unsigned char>(text[i + k]);
+                if ((continuation >> 6) != 0x2) return false;
+                codePoint = (codePoint << 6) | (continuation & 0x3F);
+            }
+            static constexpr uint32_t minimum[] = {0, 0, 0x80, 0x800, 0x10000};
+            if (codePoint < minimum[length] || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) return false;
+            i += length;
+        }
+        return true;
+    }
+
+    std::string toText(const pqxx::bytes& bytes) {
+        return {reinterpret_cast<const char*>(bytes.data()), bytes.size()};
+    }
 
-        // Query to get headers for the current email
-        pqxx::result headers = trans.exec("SELECT emailheaderkeyid, headerkey FROM emailheaderkey WHERE emailid = $1", pqxx::params(emailId));
+    // Where each EmailListFilter field lives: the tables joined to reach it from email, and the column matched.
+    struct PushdownField {
+        const char* name;
+        const char* from;
+        const char* column;
+    };
 
-        for (const auto& headerRow : headers) {
-            int emailheaderkeyid = headerRow[0].as<int>();
-            std::string headerKey = headerRow[1].as<std::string>();
+    // attributeval holds "<type>:<value>", EmailListFilter matches the value part.
+    constexpr const char* ATTRIBUTE_VALUE = "substring(a.attributeval from position(':'::bytea in a.attributeval) + 1)";
 
-            // Query to get values for each header key
-            pqxx::result values = trans.exec("SELECT headerval FROM emailheaderval WHERE headerkeyid = $1",
-                                              pqxx::params(emailheaderkeyid));
+    // Matches encode(bytes, 'escape') of the bytes convert_from(bytes, 'UTF8') accepts. That form escapes zero and
+    // high bytes as \ooo and doubles backslashes, so each UTF-8 sequence becomes a fixed run of octal escapes.
+    constexpr const char* VALID_UTF8_ESCAPED =
+        R"(^(?:[^\\]|\\\\|\\(?:30[2-7]|3[1-3][0-7])\\2[0-7]{2}|\\340\\2[4-7][0-7]\\2[0-7]{2}|\\(?:34[1-7]|35[0-467])(?:\\2[0-7]{2}){2}|\\355\\2[0-3][0-7]\\2[0-7]{2}|\\360\\2[2-7][0-7](?:\\2[0-7]{2}){2}|\\36[1-3](?:\\2[0-7]{2}){3}|\\364\\2[01][0-7](?:\\2[0-7]{2}){2})*$)";
 
-            for (const auto& valueRow : values) {
-                std::string headerValue = valueRow[0].as<std::string>();
-                newEmail.setHeader(headerKey, headerValue); // Assuming addHeader method exists in Email class
-            }
+    constexpr PushdownField PUSHDOWN_FIELDS[] = {
+        {"headerKey", "emailheaderkey k WHERE k.emailid = email.emailid", "k.headerkey"},
+        {"headerVal", "emailheaderkey k JOIN emailheaderval v ON v.headerkeyid = k.emailheaderkeyid WHERE k.emailid = email.emailid", "v.headerval"},
+        {"attributeKey", "attributebag a WHERE a.emailid = email.emailid", "a.attributekey"},
+        {"attributeVal", "attributebag a WHERE a.emailid = email.emailid", ATTRIBUTE_VALUE},
+        {"body", "emailpart p WHERE p.emailid = email.emailid", "p.partbody"},
+        {"MIMEPartKey", "emailpart p JOIN emailpartheaderkey k ON k.emailpartid = p.emailpartid WHERE p.emailid = email.emailid", "k.headerkey"},
+        {"MIMEPartVal", "emailpart p JOIN emailpartheaderkey k ON k.emailpartid = p.emailpartid "
+                        "JOIN emailpartheaderval v ON v.emailpartheaderkeyid = k.emailpartheaderkeyid WHERE p.emailid = email.emailid", "v.headerval"},
+    };
+}
+
+std::vector<Email> PostgresqlReader::readSelection(pqxx::transaction_base& trans) {
+    // One streamed query per table over selected_email, each sorted by emailid, merged against the sorted email list in one pass.
+    std::vector<PendingEmail> pending;
+    for (auto [emailId, isMimeMultipart] : trans.stream<int64_t, bool>(
+             "SELECT emailid, ismimemultipart FROM selected_email ORDER BY emailid")) {
+        PendingEmail& entry = pending.emplace_back();
+        entry.emailid = emailId;
+        entry.email.setIsMIMEMultipart(isMimeMultipart);
+    }
+
+    size_t cursor = 0;
+    for (auto [emailId, headerKey, headerValue] : trans.stream<int64_t, std::string, std::string>(
+             "SELECT k.emailid, k.headerkey, v.headerval FROM emailheaderkey k "
+             "JOIN selected_email s ON s.emailid = k.emailid "
+             "JOIN emailheaderval v ON v.headerkeyid = k.emailheaderkeyid "
+             "ORDER BY k.emailid, k.emailheaderkeyid")) {
+        if (PendingEmail* entry = seek(pending, cursor, &PendingEmail::emailid, emailId)) {
+            entry->email.setHeader(headerKey, headerValue);
         }
-        try {
-            pqxx::result attributes = trans.exec("SELECT attributekey, convert_from(attributeval, 'UTF-8') FROM attributebag WHERE emailid = $1", pqxx::params(emailId));
-            for (const auto& attributeRow : attributes) {
-                std::string key = attributeRow[0].as<std::string>();
-                std::string value = attributeRow[1].as<std::string>();
-                newEmail.insertAttribute(key, AttributeBagRegistry::deserializeAttribute(value));
-            }
-        } catch (const std::exception& e) {
-            LOG_ERROR << "PostgresqlReader exception: " << e.what();
+    }
+
+    cursor = 0;
+    for (auto [emailId, attributeKey, attributeValue] : trans.stream<int64_t, std::string, pqxx::bytes>(
+             "SELECT a.emailid, a.attributekey, a.attributeval FROM attributebag a "
+             "JOIN selected_email s ON s.emailid = a.emailid ORDER BY a.emailid")) {
+        PendingEmail* entry = seek(pending, cursor, &PendingEmail::emailid, emailId);
+        if (!entry) continue;
+        std::string value = toText(attributeValue);
+        if (!isValidUtf8(value)) {
+            LOG_ERROR << "PostgresqlReader exception: attribute " << attributeKey << " of email " << emailId << " is not valid UTF-8.";
+            continue;
         }
+        entry->email.insertAttribute(attributeKey, AttributeBagRegistry::deserializeAttribute(value));
+    }
 
+    cursor = 0;
+    for (auto [emailId, partId, partBody] : trans.stream<int64_t, int64_t, pqxx::bytes>(
+             "SELECT p.emailid, p.emailpartid, p.partbody FROM emailpart p "
+             "JOIN selected_email s ON s.emailid = p.emailid ORDER BY p.emailid, p.emailpartid")) {
+        if (PendingEmail* entry = seek(pending, cursor, &PendingEmail::emailid, emailId)) {
+            entry->parts.push_back({partId, toText(partBody), {}});
+        }
+    }
 
+    PartHeaderMerger partHeaderMerger(pending);
+    for (auto [partId, headerKey, headerValue] : trans.stream<int64_t, std::string, std::optional<std::string>>(
+             "SELECT k.emailpartid, k.headerkey, v.headerval FROM emailpartheaderkey k "
+             "JOIN emailpart p ON p.emailpartid = k.emailpartid "
+             "JOIN selected_email s ON s.emailid = p.emailid "
+             "LEFT JOIN emailpartheaderval v ON v.emailpartheaderkeyid = k.emailpartheaderkeyid "
+             "ORDER BY p.emailid, k.emailpartid, k.emailpartheaderkeyid")) {
+        if (!partHeaderMerger.add(partId, headerKey, std::move(headerValue))) break;
+    }
 
-        std::unique_ptr<EmailBody> partBodies;
-
-        // Query to get parts for the current email if it's multipart
-        if (isMimeMultipart) {
-            pqxx::result parts = trans.exec("SELECT emailpartid, partbody FROM emailpart WHERE emailid = $1", pqxx::params(emailId));
-            partBodies = std::make_unique<MIMEMultipartBodies>();
-            for (const auto& partRow : parts) {
-                int partId = partRow[0].as<int>();
-                std::string partBody = partRow[1].as<std::string>();
-
-                pqxx::result mimeHeaders = trans.exec("SELECT emailpartheaderkeyid, headerkey FROM emailpartheaderkey WHERE emailpartid = $1", pqxx::params(partId));
-                std::pmr::map<std::string, std::vector<std::string>> headerMap;
-
-                for (const auto& headerRow : mimeHeaders) {
-                    int emailpartheaderkeyid = headerRow[0].as<int>();
-                    std::string headerKey = headerRow[1].as<std::string>();
-
-                    pqxx::result mimeValues = trans.exec("SELECT headerval FROM emailpartheaderval WHERE emailpartheaderkeyid = $1", pqxx::params(emailpartheaderkeyid));
-                    std::vector<std::string> headerValues;
-                    for (const auto& valueRow : mimeValues) {
-                        std::string headerValue = valueRow[0].as<std::string>();
-                        headerValues.push_back(headerValue);
-                    }
-                    headerMap[headerKey] = headerValues;
-                }
-
-                pqxx::result convertedBody;
-                try {
-                    convertedBody = trans.exec("SELECT convert_from($1::bytea, $2)", pqxx::params(partBody, "UTF-8"));
-                } catch (const std::exception& e) {
-                    LOG_ERROR << "Error converting body: " << e.what();
-                    LOG_ERROR << "Skipping email.";
-                    continue;
-                }
-                std::string encodedPartBody = convertedBody[0][0].as<std::string>();
-
-                dynamic_cast<MIMEMultipartBodies*>(partBodies.get())->addPart(headerMap, encodedPartBody);
-            }
-            newEmail.setBody(std::move(partBodies));
-        } else {
-            pqxx::result standardBody = trans.exec("SELECT partbody FROM emailpart WHERE emailid = $1", pqxx::params(emailId));
-            partBodies = std::make_unique<StandardEmailBody>();
-            auto body = standardBody[0][0].as<std::string>();
-
-            pqxx::result convertedBody;
-            try {
-                convertedBody = trans.exec("SELECT convert_from($1::bytea, $2)", pqxx::params(body, "utf-8"));
-            } catch (const std::exception& e) {
-                LOG_ERROR << "Error converting body: " << e.what();
-                LOG_ERROR << "Skipping email.";
-                continue;
-            }
-            std::string encodedBody = convertedBody[0][0].as<std::string>();
-            dynamic_cast<StandardEmailBody*>(partBodies.get())->setContent(encodedBody);
-            newEmail.setBody(std::move(partBodies));
+    std::string destination = PostgresqlConnectionPool::makeDestination(optionConfig_["databasePath"], optionConfig_["schemaName"], optionConfig_["datasetName"]);
+    std::vector<Email> emails;
+    emails.reserve(pending.size());
+    for (PendingEmail& entry : pending) {
+        Email& newEmail = entry.email;
+        if (newEmail.getIsMIMEMultipart()) {
+            std::erase_if(entry.parts, [](const PendingPart& part) {
+                if (isValidUtf8(part.body)) return false;
+                LOG_ERROR << "Error converting body: part " << part.emailpartid << " is not valid UTF-8.";
+                LOG_ERROR << "Skipping part.";
+                return true;
+            });
+        } else if (!entry.parts.empty() && !isValidUtf8(entry.parts.front().body)) {
+            LOG_ERROR << "Error converting body: email " << entry.emailid << " is not valid UTF-8.";
+            LOG_ERROR << "Skipping email.";
+            continue;
         }
-        bool isUnique = true;
+        assembleBody(entry);
         newEmail.generateUniqueHash();
-        for (const auto& email : *emailList) {
-            if (email.getUniqueHash() == newEmail.getUniqueHash()) {
-                LOG_INFO << "Email already exists: " << email.getUniqueHash();
-                isUnique = false;
+        newEmail.markAttributesSaved(destination); // Matches the dataset, so a delta save into it has nothing to write yet.
+        emails.push_back(std::move(newEmail));
+    }
+    return emails;
+}
+
+std::string PostgresqlReader::buildSelection(pqxx::transaction_base& trans, pqxx::params& values, int datasetid) {
+    std::string condition = "datasetid = $" + std::to_string(values.size() + 1);
+    values.append(datasetid);
+    for (const auto& filter : optionConfig_["filters"]) {
+        condition += " AND " + trans.quote_name(filter["columnName"].get<std::string>()) +
+                     " " + filter["condition"].get<std::string>() + " $" + std::to_string(values.size() + 1);
+        values.append(filter["value"].get<std::string>());
+    }
+    if (optionConfig_.contains("emailFilters")) {
+        for (const auto& filter : optionConfig_["emailFilters"]) {
+            for (const auto& field : filter["fields"]) {
+                condition += " AND " + buildPushdown(field, values);
             }
         }
-        if (isUnique) {
-            LOG_INFO << "Email doesn't exist: " << newEmail.getUniqueHash() << ", file: " << (newEmail.getAttributeValue("File identifier")->toString());
-            emailList->insertEmail(newEmail);
+    }
+    return condition;
+}
+
+std::string PostgresqlReader::buildPushdown(const nlohmann::json& field, pqxx::params& values) {
+    // An email passes a field if it has (include) or lacks (exclude) a matching row, the same rule EmailListFilter
+    // applies in memory. Each field becomes an EXISTS subquery correlated on emailid, which the planner runs as a
+    // semi-join over the indexed child tables.
+    std::string name = field["value"].get<std::string>();
+    auto it = std::ranges::find_if(PUSHDOWN_FIELDS, [&name](const PushdownField& candidate) { return name == candidate.name; });
+    if (it == std::end(PUSHDOWN_FIELDS)) {
+        throw std::invalid_argument("emailFilters field " + name + " cannot be evaluated by the database");
+    }
+    std::string column = it->column;
+    bool isBytes = name == "body" || name == "attributeVal";
+    bool byRegex = field["filterBy"].get<std::string>() == "regex";
+
+    std::string match;
+    std::string validUtf8;
+    if (isBytes && byRegex) {
+        validUtf8 = "$" + std::to_string(values.size() + 1);
+        values.append(VALID_UTF8_ESCAPED);
+    }
+    for (const auto& filterValue : field["filterVals"]) {
+        std::string placeholder = "$" + std::to_string(values.size() + 1);
+        if (!match.empty()) match += " OR ";
+        if (!byRegex) {
+            match += column + " = " + (isBytes ? "convert_to(" + placeholder + ", 'UTF8')" : placeholder);
+            values.append(filterValue["filterValue"].get<std::string>());
+            continue;
+        }
+        // EmailListFilter uses regex_match, so the pattern must match the whole value. Bytes that are not valid
+        // UTF-8 match nothing, as convert_from() would otherwise fail the whole read over one bad part.
+        std::string text = isBytes ? "CASE WHEN encode(" + column + ", 'escape') ~ " + validUtf8 + " THEN convert_from(" + column + ", 'UTF8') END" : column;
+        if (name == "attributeVal") {
+            // Binary attributes have no text form to match against.
+            text = "CASE WHEN position('AttributeBagBlob:'::bytea in a.attributeval) = 1 OR "
+                   "position('AttributeBagBinary:'::bytea in a.attributeval) = 1 THEN NULL ELSE " + text + " END";
         }
+        match += "(" + text + ") ~ " + placeholder;
+        values.append("^(?:" + filterValue["filterValue"].get<std::string>() + ")$");
+    }
+    if (match.empty()) match = "false";
+
+    bool include = field["outcome"].get<std::string>() == "include";
+    return std::string(include ? "" : "NOT ") + "EXISTS (SELECT 1 FROM " + it->from + " AND (" + match + "))";
+}
 
+void PostgresqlReader::selectEmails(pqxx::transaction_base& trans, int datasetid, std::optional<std::pair<int64_t, int64_t>> idRange, size_t limit) {
+    // The selection is materialised once, so every per-table query can join against it.
+    pqxx::params values;
+    std::string query = "CREATE TEMP TABLE selected_email ON COMMIT DROP AS "
+                        "SELECT emailid, ismimemultipart FROM email WHERE " + buildSelection(trans, values, datasetid);
+    if (idRange) {
+        query += " AND emailid > $" + std::to_string(values.size() + 1) + " AND emailid <= $" + std::to_string(values.size() + 2);
+        values.append(idRange->first);
+        values.append(idRange->second);
+    }
+    if (limit > 0) {
+        query += " ORDER BY emailid LIMIT " + std::to_string(limit);
     }
+    trans.exec("DROP TABLE IF EXISTS selected_email");
+    trans.exec(query, values);
 }
 
 bool PostgresqlReader::execute(EmailListView * emailList) {
+    return executeAsSource(emailList, {});
+}
+
+bool PostgresqlReader::executeAsSource(EmailListView* emailList, const BatchSink& sink) {
     LOG_INFO << "Reading from database.";
     SET_PLUGIN_STATE("RUNNING");
+    bool status = true;
     try {
-        pqxx::connection cx{optionConfig_["databasePath"]};
-        pqxx::work trans(cx);
-        std::string schema = optionConfig_["schemaName"];
-        trans.exec("SET search_path TO " + trans.quote_name(schema) + ", public");
+        size_t partitions = optionConfig_.value("connections", 1);
+        size_t batchSize = optionConfig_.value("batchSize", 0);
+        if (batchSize > 0 && partitions > 1) {
+            LOG_WARNING << "PostgresqlReader reads batches on a single connection, ignoring connections.";
+            partitions = 1;
+        }
+        BatchDelivery delivery(emailList, sink, "PostgresqlReader");
+
+        // One more connection than partitions, for the coordinating transaction.
+        PostgresqlConnectionPool pool(optionConfig_["databasePath"], optionConfig_["schemaName"], partitions > 1 ? partitions + 1 : 1);
+        auto cx = pool.acquire();
+        pqxx::transaction<pqxx::isolation_level::repeatable_read> trans(*cx);
 
         // Query to get all datasets
         pqxx::result dataset = trans.exec("SELECT datasetid FROM dataset WHERE datasetname = $1", pqxx::params(optionConfig_["datasetName"].get<std::string>()));
 
         int datasetid = dataset[0][0].as<int>();
-        if (optionConfig_["filters"].empty()) {
-            pqxx::result emails = trans.exec("SELECT emailid, fileidentifier, ismimemultipart FROM email WHERE datasetid = $1", pqxx::params(datasetid));
-            getEmails(emails, trans, emailList);
+        if (batchSize > 0) {
+            // Keyset pagination over emailid: each batch starts after the last id of the one before.
+            int64_t lastId = std::numeric_limits<int64_t>::min();
+            for (;;) {
+                selectEmails(trans, datasetid, std::pair(lastId, std::numeric_limits<int64_t>::max()), batchSize);
+                pqxx::result selected = trans.exec("SELECT count(*), max(emailid) FROM selected_email");
+                if (selected[0][0].as<int64_t>() == 0) break;
+                lastId = selected[0][1].as<int64_t>();
+                delivery.deliver(readSelection(trans));
+            }
+        } else if (partitions == 1) {
+            selectEmails(trans, datasetid);
+            delivery.deliver(readSelection(trans));
         } else {
-            std::string query = "SELECT emailid, fileidentifier, ismimemultipart FROM email WHERE datasetid = $1";
-            pqxx::params values;
-            values.append(datasetid);
+            // Every partition reads the coordinator's snapshot, so together they see one consistent dataset.
+            std::string snapshot = trans.exec("SELECT pg_export_snapshot()")[0][0].as<std::string>();
 
-            for (const auto& filter : optionConfig_["filters"]) {
-                query += " AND " + trans.quote_name(filter["columnName"].get<std::string>()) +
-                         " " + filter["condition"].get<std::string>() + " $" + std::to_string(values.size() + 1);
-                values.append(filter["value"].get<std::string>());
+            // Split at emailid boundaries that give each partition a similar number of emails.
+            pqxx::params values;
+            std::string condition = buildSelection(trans, values, datasetid);
+            std::vector<int64_t> bounds;
+            for (const auto& row : trans.exec("SELECT max(emailid) FROM (SELECT emailid, ntile(" + std::to_string(partitions) +
+                                              ") OVER (ORDER BY emailid) AS bucket FROM email WHERE " + condition +
+                                              ") AS buckets GROUP BY bucket ORDER BY bucket", values)) {
+                bounds.push_back(row[0].as<int64_t>());
             }
 
-            pqxx::result emails = trans.exec(query, values);
-            getEmails(emails, trans, emailList);
+            std::vector<std::vector<Email>> results(bounds.size());
+            TaskGroup group(*WorkStealingPool::getInstance());
+            for (size_t i = 0; i < bounds.size(); ++i) {
+                group.run([&, i] {
+                    auto partitionConnection = pool.acquire();
+                    pqxx::transaction<pqxx::isolation_level::repeatable_read> partition(*partitionConnection);
+                    partition.exec("SET TRANSACTION SNAPSHOT " + partition.quote(snapshot));
+                    selectEmails(partition, datasetid, std::pair(i == 0 ? std::numeric_limits<int64_t>::min() : bounds[i - 1], bounds[i]));
+                    results[i] = readSelection(partition);
+                });
+            }
+            group.wait();
+            std::vector<Email> emails;
+            for (std::vector<Email>& result : results) {
+                std::move(result.begin(), result.end(), std::back_inserter(emails));
+            }
+            delivery.deliver(std::move(emails));
         }
+        status = delivery.finish();
         LOG_INFO << "Emails successfully read from the database.";
     } catch (const std::exception &e) {
         LOG_ERROR << "Exception occurred during database read operation: " << e.what();
         SET_PLUGIN_STATE("FAILED");
         return false;
     }
-    SET_PLUGIN_STATE("COMPLETE");
-    return true;
+    status ? SET_PLUGIN_STATE("COMPLETE") : SET_PLUGIN_STATE("FAILED");
+    return status;
 }
@@ -2,12 +2,15 @@
 
 #include "PluginRunnableInterface.hpp"
 #include <pqxx/pqxx>
+#include <unordered_map>
+
+class PostgresqlConnectionPool;
 
 class Email;
 // PostgresqlSaver class implementing PluginInterface
 class PostgresqlSaver final : public PluginRunnableInterface {
 public:
-    explicit PostgresqlSaver(std::string&);  // Constructor
+    explicit PostgresqlSaver(const std::string&);  // Constructor
 
     bool instantiateRecursive() override;
     nlohmann::json printRecursiveInstanceTreeJson() override;
@@ -17,7 +20,7 @@ public:
 
 private:
     int getOrCreateDataset(pqxx::work& trans);
-    void clearDatabase();
+    void clearDatabase(pqxx::work& trans, bool restartIdentity);
     int addEmail(pqxx::work& trans, int datasetid, const Email& email);
     int addHeaderKey(pqxx::work& trans, int emailid, const std::string& key);
     void addHeaderValue(pqxx::work& trans, int headerkeyid, const std::string& value);
@@ -25,6 +28,19 @@ private:
     int addEmailPartHeaderKey(pqxx::work& trans, int emailpartid, const std::string& key);
     void addEmailPartHeaderValue(pqxx::work& trans, int emailpartheaderkeyid, const std::string& value);
     void addAttribute(pqxx::work& trans, int emailid,const std::string& attributekey, const std::string& attributeval);
+    void prepareSchema(pqxx::connection& cx, bool delta);
+    void provisionSchema(pqxx::work& trans);
+    void compressColumns(pqxx::connection& cx);
+    void resolveHeaderNames(pqxx::connection& cx, EmailListView* emailList);
+    std::pair<size_t, size_t> saveDelta(pqxx::work& trans, int datasetid, EmailListView* emailList, bool bulk, const std::string& destination);
+    void insertRowByRow(pqxx::work& trans, int datasetid, EmailListView* emailList);
+    void insertBulk(pqxx::work& trans, int datasetid, EmailListView* emailList, const std::string& tablePrefix = "");
+    void insertPartitioned(PostgresqlConnectionPool& pool, EmailListView* emailList, size_t partitions);
+    std::vector<int64_t> reserveIds(pqxx::work& trans, const std::string& table, const std::string& column, size_t count);
+
+    bool normalizedHeaders_ = false; // Header keys are stored as headername ids, see provisionSchema.
+    bool uniqueHashes_ = true; // The email table has the uniquehash column, see prepareSchema.
+    std::unordered_map<std::string, int> headerNameIds_;
     /* Self registration for plugin registry
      struct Register {
          Register() {
@@ -69,4 +85,14 @@ private:
      static inline Register reg;
      */
 
+    struct Register {
+        Register() {
+            std::string name = "PostgresqlSaver";
+            LOG_DEBUG_VERBOSE << "Registering plugin " << name;
+            Plugins->registerPlugin(name, [](const std::string& instanceID) -> PluginInterface* {
+                return new PostgresqlSaver(instanceID);
+            });
+        }
+    };
+    static inline Register reg;
 };
\ No newline at end of file
@@ -11,11 +11,19 @@
 #include <vector>
 #include <filesystem>
 #include <pqxx/pqxx>
+#include <chrono>
+#include "PostgresqlConnectionPool.hpp"
+#include "WorkStealingPool.hpp"
 #include <ctime>
+#include <algorithm>
+#include <set>
+#include <span>
+#include <unordered_set>
+#include <string_view>
 
 // Constructor
-PostgresqlSaver::PostgresqlSaver(std::string& instanceID) : PluginRunnableInterface(instanceID) {
-    pluginName_ = "DummyPlugin";
+PostgresqlSaver::PostgresqlSaver(const std::string& instanceID) : PluginRunnableInterface(instanceID) {
+    pluginName_ = "PostgresqlSaver";
     instanceID_ = instanceID;
     optionSchema_ = R"(
 {
@@ -37,6 +45,34 @@ PostgresqlSaver::PostgresqlSaver(std::string& instanceID) : PluginRunnableInterf
       "datasetDescription": {
         "type": "string",
         "description": "A description of the dataset."
+      },
+      "mode": {
+        "type": "string",
+        "enum": ["replace", "delta"],
+        "default": "replace",
+        "description": "replace clears every table and writes all emails. delta keeps what is saved, adds new emails and upserts changed attributes."
+      },
+      "bulkInsert": {
+        "type": "boolean",
+        "default": true,
+        "description": "Stream each table with COPY instead of inserting one row per statement."
+      },
+      "connections": {
+        "type": "integer",
+        "minimum": 1,
+        "default": 1,
+        "description": "Number of partitions written in parallel, each on its own connection. Requires bulkInsert."
+      },
+      "bulkChunkSize": {
+        "type": "integer",
+        "minimum": 1,
+        "default": 1024,
+        "description": "Number of emails buffered per COPY round when bulkInsert is enabled."
+      },
+      "provisionSchema": {
+        "type": "boolean",
+        "default": false,
+        "description": "Create or migrate the schema's tables, with indexes, a header name dictionary and lz4 compressed bodies."
       }
     },
     "required": [
@@ -77,18 +113,6 @@ PostgresqlSaver::~PostgresqlSaver() = default;
 
 
 
-void PostgresqlSaver::clearDatabase() {
-    pqxx::connection cx{optionConfig_["databasePath"]};
-    pqxx::work clear_trans(cx);
-    std::string schema = optionConfig_["schemaName"];
-    clear_trans.exec("SET search_path TO " + clear_trans.quote_name(schema) + ", public");
-
-    clear_trans.exec("TRUNCATE TABLE dataset, email, emailheaderkey, emailheaderval, emailpart, emailpartheaderkey, emailpartheaderval, attributebag RESTART IDENTITY");
-    clear_trans.commit();
-    LOG_INFO << "Database cleared.";
-}
-
-
 int PostgresqlSaver::getOrCreateDataset(pqxx::work& trans) {
     std::string datasetName = optionConfig_["datasetName"];
     std::string datasetDescription = optionConfig_["datasetDescription"];
@@ -101,115 +125,662 @@ int PostgresqlSaver::getOrCreateDataset(pqxx::work& trans) {
     return res[0][0].as<int>();
 }
 
+namespace {
+    // Statements run once per row, prepared on every pooled connection so the server parses and plans them once.
+    constexpr std::pair<const char*, const char*> PREPARED_STATEMENTS[] = {
+        {"insert_email", "INSERT INTO email (datasetid, fileidentifier, filedatetime, ismimemultipart, uniquehash) "
+                         "VALUES ($1, $2, CURRENT_TIMESTAMP, $3, $4) RETURNING emailid"},
+        {"insert_header_key", "INSERT INTO emailheaderkey (emailid, headerkey) VALUES ($1, $2) RETURNING emailheaderkeyid"},
+        {"insert_header_value", "INSERT INTO emailheaderval (headerkeyid, headerval) VALUES ($1, $2)"},
+        {"insert_part", "INSERT INTO emailpart (emailid, partbody) VALUES ($1, $2) RETURNING emailpartid"},
+        {"insert_part_header_key", "INSERT INTO emailpartheaderkey (emailpartid, headerkey) VALUES ($1, $2) RETURNING emailpartheaderkeyid"},
+        {"insert_part_header_value", "INSERT INTO emailpartheaderval (emailpartheaderkeyid, headerval) VALUES ($1, $2)"},
+        {"insert_attribute", "INSERT INTO attributebag (emailid, attributekey, attributeval, datemodified) VALUES ($1, $2, $3::bytea, CURRENT_TIMESTAMP)"},
+    };
+
+    // Replace the header key inserts above when header names are normalized. Keys are then passed as headername ids.
+    constexpr std::pair<const char*, const char*> NORMALIZED_STATEMENTS[] = {
+        {"insert_header_key", "INSERT INTO emailheadername (emailid, headernameid) VALUES ($1, $2) RETURNING emailheaderkeyid"},
+        {"insert_part_header_key", "INSERT INTO emailpartheadername (emailpartid, headernameid) VALUES ($1, $2) RETURNING emailpartheaderkeyid"},
+    };
+
+    // Replaces insert_email on databases without the uniquehash column.
+    constexpr std::pair<const char*, const char*> UNHASHED_STATEMENTS[] = {
+        {"insert_email", "INSERT INTO email (datasetid, fileidentifier, filedatetime, ismimemultipart) "
+                         "VALUES ($1, $2, CURRENT_TIMESTAMP, $3) RETURNING emailid"},
+    };
+
+    // Attribute upserts sent by one execution of upsert_attribute_batch. Three parameters each, well under
+    // the protocol's limit of 65535.
+    constexpr size_t UPSERT_BATCH = 256;
+
+    // Upserts that many attributes at once, given as (emailid, attributekey, attributeval) parameter triples.
+    // Prepared only in delta mode, as ON CONFLICT needs the unique index that mode creates.
+    std::string upsertAttributeStatement(size_t rows) {
+        std::string statement = "INSERT INTO attributebag (emailid, attributekey, attributeval, datemodified) VALUES ";
+        for (size_t row = 0; row < rows; ++row) {
+            std::string first = std::to_string(row * 3 + 1);
+            statement += (row ? ", ($" : "($") + first + ", $" + std::to_string(row * 3 + 2) + ", $" + std::to_string(row * 3 + 3) +
+                         "::bytea, CURRENT_TIMESTAMP)";
+        }
+        return statement + " ON CONFLICT (emailid, attributekey) DO UPDATE SET attributeval = EXCLUDED.attributeval, "
+                           "datemodified = EXCLUDED.datemodified WHERE attributebag.attributeval IS DISTINCT FROM EXCLUDED.attributeval";
+    }
+}
+
 int PostgresqlSaver::addEmail(pqxx::work & trans, int datasetid, const Email &email) {
-    pqxx::result res = trans.exec(
-        "INSERT INTO email (datasetid, fileidentifier, filedatetime, ismimemultipart) "
-        "VALUES ($1, $2, CURRENT_TIMESTAMP, $3) RETURNING emailid",
-        {datasetid, email.getAttributeValue("File identifier")->toString(), email.getIsMIMEMultipart()}
-    );
+    std::string fileIdentifier = email.getAttributeValue("File identifier")->toString();
+    pqxx::result res = uniqueHashes_ ? trans.exec_prepared("insert_email", datasetid, fileIdentifier, email.getIsMIMEMultipart(),
+                                                           static_cast<int64_t>(email.getUniqueHash()))
+                                     : trans.exec_prepared("insert_email", datasetid, fileIdentifier, email.getIsMIMEMultipart());
     return res[0][0].as<int>();
 }
 
 int PostgresqlSaver::addHeaderKey(pqxx::work& trans, int emailid, const std::string& key) {
-    pqxx::result res = trans.exec(
-        "INSERT INTO emailheaderkey (emailid, headerkey) VALUES ($1, $2) RETURNING emailheaderkeyid",
-        {emailid, key}
-    );
+    pqxx::result res = normalizedHeaders_ ? trans.exec_prepared("insert_header_key", emailid, headerNameIds_.at(key))
+                                          : trans.exec_prepared("insert_header_key", emailid, key);
     return res[0][0].as<int>();
 }
 
 void PostgresqlSaver::addHeaderValue(pqxx::work& trans, int headerkeyid, const std::string& value) {
-    pqxx::result res = trans.exec(
-        "INSERT INTO emailheaderval (headerkeyid, headerval) VALUES ($1, $2)",
-        {headerkeyid, value}
-    );
+    trans.exec_prepared("insert_header_value", headerkeyid, value);
 }
 
 int PostgresqlSaver::addEmailPart(pqxx::work& trans, int emailid, const std::string& partBody) {
-    pqxx::result res = trans.exec(
-        "INSERT INTO emailpart (emailid, partbody) VALUES ($1, $2) RETURNING emailpartid",
-        {emailid, pqxx::binary_cast(partBody)}
-    );
+    pqxx::result res = trans.exec_prepared("insert_part", emailid, pqxx::binary_cast(partBody));
     return res[0][0].as<int>();
 }
 
 int PostgresqlSaver::addEmailPartHeaderKey(pqxx::work& trans, int emailpartid, const std::string& key) {
-    pqxx::result res = trans.exec(
-        "INSERT INTO emailpartheaderkey (emailpartid, headerkey) VALUES ($1, $2) RETURNING emailpartheaderkeyid",
-        {emailpartid, key}
-    );
+    pqxx::result res = normalizedHeaders_ ? trans.exec_prepared("insert_part_header_key", emailpartid, headerNameIds_.at(key))
+                                          : trans.exec_prepared("insert_part_header_key", emailpartid, key);
     return res[0][0].as<int>();
 }
 
 void PostgresqlSaver::addEmailPartHeaderValue(pqxx::work& trans, int emailpartheaderkeyid, const std::string& value) {
-    pqxx::result res = trans.exec(
-        "INSERT INTO emailpartheaderval (emailpartheaderkeyid, headerval) VALUES ($1, $2)",
-        {emailpartheaderkeyid, value}
-    );
+    trans.exec_prepared("insert_part_header_value", emailpartheaderkeyid, value);
 }
 
 void PostgresqlSaver::addAttribute(pqxx::work& trans, int emailid, const std::string& attributekey, const std::string& attributeval) {
-    pqxx::result res = trans.exec(
-        "INSERT INTO attributebag (emailid, attributekey, attributeval, datemodified) VALUES ($1, $2, $3::bytea, CURRENT_TIMESTAMP)",
-        {emailid, attributekey, pqxx::binary_cast(attributeval)}
-    );
+    trans.exec_prepared("insert_attribute", emailid, attributekey, pqxx::binary_cast(attributeval));
 }
 
-bool PostgresqlSaver::execute(EmailListView * emailList) {
-    LOG_INFO << "Writing to database";
-    SET_PLUGIN_STATE("RUNNING");
-    try {
-        clearDatabase();
-        pqxx::connection cx{optionConfig_["databasePath"]};
-        pqxx::work insert_trans(cx);
-        std::string schema = optionConfig_["schemaName"];
-        insert_trans.exec("SET search_path TO " + insert_trans.quote_name(schema) + ", public");
-        int datasetid = getOrCreateDataset(insert_trans);
-
-        for (Email& email : *emailList) {
+namespace {
+    // Tables in the order they are written, parents before children, with the columns bulk inserts fill.
+    // Columns left out (the ids of leaf tables) are filled from their defaults.
+    enum BulkTable { EMAIL, HEADER_KEY, HEADER_VALUE, PART, PART_HEADER_KEY, PART_HEADER_VALUE, ATTRIBUTE };
+    constexpr std::pair<const char*, const char*> BULK_TABLES[] = {
+        {"email", "emailid, datasetid, fileidentifier, filedatetime, ismimemultipart, uniquehash"},
+        {"emailheaderkey", "emailheaderkeyid, emailid, headerkey"},
+        {"emailheaderval", "headerkeyid, headerval"},
+        {"emailpart", "emailpartid, emailid, partbody"},
+        {"emailpartheaderkey", "emailpartheaderkeyid, emailpartid, headerkey"},
+        {"emailpartheaderval", "emailpartheaderkeyid, headerval"},
+        {"attributebag", "emailid, attributekey, attributeval, datemodified"},
+    };
+    constexpr const char* STAGING_PREFIX = "staging_";
 
-            // Add email, get email ID
-            int emailid = addEmail(insert_trans, datasetid, email);
+    // With normalized header names, header keys are written here by headername id. emailheaderkey and
+    // emailpartheaderkey are then views over these tables, so readers see the same columns either way.
+    constexpr std::pair<const char*, const char*> NORMALIZED_HEADER_TABLES[] = {
+        {"emailheadername", "emailheaderkeyid, emailid, headernameid"},
+        {"emailpartheadername", "emailpartheaderkeyid, emailpartid, headernameid"},
+    };
 
-            // For each header
-            for (auto& header : email.getHeader()) {
-                // Add key, get key ID
-                int emailheaderkeyid = addHeaderKey(insert_trans, emailid, header.first);
+    // Databases that predate unique hashes keep their email table as it was, unless delta mode or provisioning adds the column.
+    constexpr std::pair<const char*, const char*> UNHASHED_EMAIL_TABLE = {"email", "emailid, datasetid, fileidentifier, filedatetime, ismimemultipart"};
 
-                // For each header value
-                addHeaderValue(insert_trans, emailheaderkeyid, header.second);
-            }
+    std::pair<const char*, const char*> bulkTable(size_t table, bool normalizedHeaders, bool uniqueHashes) {
+        if (!uniqueHashes && table == EMAIL) return UNHASHED_EMAIL_TABLE;
+        if (normalizedHeaders && table == HEADER_KEY) return NORMALIZED_HEADER_TABLES[0];
+        if (normalizedHeaders && table == PART_HEADER_KEY) return NORMALIZED_HEADER_TABLES[1];
+        return BULK_TABLES[table];
+    }
 
-            EmailBody* body = email.getBody();
+    // One chunk of emails, flattened into the rows of each table. Child rows refer to their parent by
+    // its position within the chunk, which is swapped for a reserved id when the chunk is written.
+    struct BulkChunk {
+        struct EmailRow { std::string fileIdentifier; bool isMIMEMultipart; int64_t uniqueHash; };
+        struct KeyRow { size_t owner; std::string key; };
+        struct ValueRow { size_t owner; std::string value; };
+        struct PartRow { size_t email; std::string body; };
+        struct AttributeRow { size_t email; std::string key; std::string value; };
 
-            if (StandardEmailBody* standardBody = dynamic_cast<StandardEmailBody*>(body)) {
-                // Handle StandardEmailBody-specific functionality
-                addEmailPart(insert_trans, emailid, standardBody->getAllBodyData());
-                //LOG_WARNING << "STANDARD";
+        std::vector<EmailRow> emails;
+        std::vector<KeyRow> headerKeys;
+        std::vector<ValueRow> headerValues;
+        std::vector<PartRow> parts;
+        std::vector<KeyRow> partHeaderKeys;
+        std::vector<ValueRow> partHeaderValues;
+        std::vector<AttributeRow> attributes;
 
-            } else if (MIMEMultipartBodies* mimeBody = dynamic_cast<MIMEMultipartBodies*>(body)) {
-                // Handle MIMEMultipartBody-specific functionality
+        void add(const Email& email) {
+            size_t emailIndex = emails.size();
+            emails.push_back({email.getAttributeValue("File identifier")->toString(), email.getIsMIMEMultipart(), static_cast<int64_t>(email.getUniqueHash())});
+            for (auto& [key, value] : email.getHeader()) {
+                headerValues.push_back({headerKeys.size(), value});
+                headerKeys.push_back({emailIndex, key});
+            }
+            std::shared_ptr<EmailBody> body = email.getBody();
+            if (auto* standardBody = dynamic_cast<StandardEmailBody*>(body.get())) {
+                parts.push_back({emailIndex, standardBody->getAllBodyData()});
+            } else if (auto* mimeBody = dynamic_cast<MIMEMultipartBodies*>(body.get())) {
                 for (MIMEMultipartPart& multipart : mimeBody->getMultipartParts()) {
-                    int emailpartid = addEmailPart(insert_trans, emailid, multipart.getBody());
-                    for (auto& header : multipart.getHeader()) {
-                        int emailparthearderkeyid = addEmailPartHeaderKey(insert_trans, emailpartid, header.first);
-                        for (auto& headerval : header.second) {
-                            addEmailPartHeaderValue(insert_trans, emailparthearderkeyid, headerval);
+                    size_t partIndex = parts.size();
+                    parts.push_back({emailIndex, multipart.getBody()});
+                    for (auto& [key, values] : multipart.getHeader()) {
+                        for (auto& value : values) {
+                            partHeaderValues.push_back({partHeaderKeys.size(), value});
                         }
+                        partHeaderKeys.push_back({partIndex, key});
                     }
                 }
-                //LOG_WARNING << "MIME";
             } else {
-                SET_PLUGIN_STATE("FAILED");
                 LOG_ERROR << "Unknown EmailBody type";
             }
             for (std::string& attributeKey : email.getAttributeKeys()) {
-                addAttribute(insert_trans, emailid, attributeKey, email.getAttributeValue(attributeKey)->serializeToString());
-            };
+                attributes.push_back({emailIndex, attributeKey, email.getAttributeValue(attributeKey)->serializeToString()});
+            }
+        }
+
+        void clear() {
+            emails.clear();
+            headerKeys.clear();
+            headerValues.clear();
+            parts.clear();
+            partHeaderKeys.clear();
+            partHeaderValues.clear();
+            attributes.clear();
+        }
+    };
+}
+
+void PostgresqlSaver::clearDatabase(pqxx::work& trans, bool restartIdentity) {
+    // Runs in the transaction that writes the new rows, so a failed save rolls the truncation back too.
+    std::string tables = "dataset";
+    for (size_t table = 0; table < std::size(BULK_TABLES); ++table) {
+        tables += std::string(", ") + bulkTable(table, normalizedHeaders_, uniqueHashes_).first;
+    }
+    trans.exec("TRUNCATE TABLE " + tables + (restartIdentity ? " RESTART IDENTITY" : ""));
+    LOG_INFO << "Database cleared.";
+}
+
+std::vector<int64_t> PostgresqlSaver::reserveIds(pqxx::work& trans, const std::string& table, const std::string& column, size_t count) {
+    std::vector<int64_t> ids;
+    if (count == 0) return ids;
+    ids.reserve(count);
+    // Draws from the column's own sequence, so ids never collide with rows inserted any other way.
+    pqxx::result res = trans.exec(
+        "SELECT nextval(pg_get_serial_sequence($1, $2)) FROM generate_series(1, $3)",
+        pqxx::params(table, column, static_cast<int64_t>(count))
+    );
+    for (const auto& row : res) {
+        ids.push_back(row[0].as<int64_t>());
+    }
+    return ids;
+}
+
+void PostgresqlSaver::insertRowByRow(pqxx::work& trans, int datasetid, EmailListView* emailList) {
+    for (Email& email : *emailList) {
+
+        // Add email, get email ID
+        int emailid = addEmail(trans, datasetid, email);
+
+        // For each header
+        for (auto& header : email.getHeader()) {
+            // Add key, get key ID
+            int emailheaderkeyid = addHeaderKey(trans, emailid, header.first);
+
+            // For each header value
+            addHeaderValue(trans, emailheaderkeyid, header.second);
+        }
+
+        std::shared_ptr<EmailBody> body = email.getBody();
+
+        if (StandardEmailBody* standardBody = dynamic_cast<StandardEmailBody*>(body.get())) {
+            // Handle StandardEmailBody-specific functionality
+            addEmailPart(trans, emailid, standardBody->getAllBodyData());
+            //LOG_WARNING << "STANDARD";
+
+        } else if (MIMEMultipartBodies* mimeBody = dynamic_cast<MIMEMultipartBodies*>(body.get())) {
+            // Handle MIMEMultipartBody-specific functionality
+            for (MIMEMultipartPart& multipart : mimeBody->getMultipartParts()) {
+                int emailpartid = addEmailPart(trans, emailid, multipart.getBody());
+                for (auto& header : multipart.getHeader()) {
+                    int emailparthearderkeyid = addEmailPartHeaderKey(trans, emailpartid, header.first);
+                    for (auto& headerval : header.second) {
+                        addEmailPartHeaderValue(trans, emailparthearderkeyid, headerval);
+                    }
+                }
+            }
+            //LOG_WARNING << "MIME";
+        } else {
+            SET_PLUGIN_STATE("FAILED");
+            LOG_ERROR << "Unknown EmailBody type";
+        }
+        for (std::string& attributeKey : email.getAttributeKeys()) {
+            addAttribute(trans, emailid, attributeKey, email.getAttributeValue(attributeKey)->serializeToString());
+        };
+    }
+}
+
+void PostgresqlSaver::insertBulk(pqxx::work& trans, int datasetid, EmailListView* emailList, const std::string& tablePrefix) {
+    // COPY cannot evaluate CURRENT_TIMESTAMP, so read it once. It is fixed for the transaction anyway.
+    std::string timestamp = trans.exec("SELECT CURRENT_TIMESTAMP::text")[0][0].as<std::string>();
+    size_t chunkSize = optionConfig_.value("bulkChunkSize", 1024);
+    BulkChunk chunk;
+
+    auto openStream = [&](BulkTable table) {
+        auto [name, columns] = bulkTable(table, normalizedHeaders_, uniqueHashes_);
+        return pqxx::stream_to::raw_table(trans, trans.quote_name(tablePrefix + name), columns);
+    };
+
+    // Per chunk: four id reservations and one COPY per table, however many rows the chunk holds.
+    auto flush = [&] {
+        if (chunk.emails.empty()) return;
+        std::vector<int64_t> emailIds = reserveIds(trans, "email", "emailid", chunk.emails.size());
+        std::vector<int64_t> headerKeyIds = reserveIds(trans, bulkTable(HEADER_KEY, normalizedHeaders_, uniqueHashes_).first, "emailheaderkeyid", chunk.headerKeys.size());
+        std::vector<int64_t> partIds = reserveIds(trans, "emailpart", "emailpartid", chunk.parts.size());
+        std::vector<int64_t> partHeaderKeyIds = reserveIds(trans, bulkTable(PART_HEADER_KEY, normalizedHeaders_, uniqueHashes_).first, "emailpartheaderkeyid", chunk.partHeaderKeys.size());
+
+        auto emails = openStream(EMAIL);
+        for (size_t i = 0; i < chunk.emails.size(); ++i) {
+            if (uniqueHashes_) {
+                emails.write_values(emailIds[i], datasetid, chunk.emails[i].fileIdentifier, timestamp, chunk.emails[i].isMIMEMultipart, chunk.emails[i].uniqueHash);
+            } else {
+                emails.write_values(emailIds[i], datasetid, chunk.emails[i].fileIdentifier, timestamp, chunk.emails[i].isMIMEMultipart);
+            }
+        }
+        emails.complete();
+
+        auto headerKeys = openStream(HEADER_KEY);
+        for (size_t i = 0; i < chunk.headerKeys.size(); ++i) {
+            if (normalizedHeaders_) {
+                headerKeys.write_values(headerKeyIds[i], emailIds[chunk.headerKeys[i].owner], headerNameIds_.at(chunk.headerKeys[i].key));
+            } else {
+                headerKeys.write_values(headerKeyIds[i], emailIds[chunk.headerKeys[i].owner], chunk.headerKeys[i].key);
+            }
+        }
+        headerKeys.complete();
+
+        auto headerValues = openStream(HEADER_VALUE);
+        for (const auto& row : chunk.headerValues) {
+            headerValues.write_values(headerKeyIds[row.owner], row.value);
+        }
+        headerValues.complete();
+
+        auto parts = openStream(PART);
+        for (size_t i = 0; i < chunk.parts.size(); ++i) {
+            parts.write_values(partIds[i], emailIds[chunk.parts[i].email], pqxx::binary_cast(chunk.parts[i].body));
+        }
+        parts.complete();
+
+        auto partHeaderKeys = openStream(PART_HEADER_KEY);
+        for (size_t i = 0; i < chunk.partHeaderKeys.size(); ++i) {
+            if (normalizedHeaders_) {
+                partHeaderKeys.write_values(partHeaderKeyIds[i], partIds[chunk.partHeaderKeys[i].owner], headerNameIds_.at(chunk.partHeaderKeys[i].key));
+            } else {
+                partHeaderKeys.write_values(partHeaderKeyIds[i], partIds[chunk.partHeaderKeys[i].owner], chunk.partHeaderKeys[i].key);
+            }
+        }
+        partHeaderKeys.complete();
+
+        auto partHeaderValues = openStream(PART_HEADER_VALUE);
+        for (const auto& row : chunk.partHeaderValues) {
+            partHeaderValues.write_values(partHeaderKeyIds[row.owner], row.value);
+        }
+        partHeaderValues.complete();
+
+        auto attributes = openStream(ATTRIBUTE);
+        for (const auto& row : chunk.attributes) {
+            attributes.write_values(emailIds[row.email], row.key, pqxx::binary_cast(row.value), timestamp);
+        }
+        attributes.complete();
+
+        chunk.clear();
+    };
+
+    for (Email& email : *emailList) {
+        chunk.add(email);
+        if (chunk.emails.size() >= chunkSize) flush();
+    }
+    flush();
+}
+
+void PostgresqlSaver::insertPartitioned(PostgresqlConnectionPool& pool, EmailListView* emailList, size_t partitions) {
+    // Partitions are committed into unlogged staging tables, and only moved into the real tables once all
+    // of them have succeeded, in the coordinating transaction that also clears the old rows and creates the dataset.
+    // They are named after the backend that creates them, which stays connected for the whole run, so
+    // concurrent saves into the same database never share them.
+    std::string stagingPrefix;
+    auto dropStaging = [&](pqxx::work& trans) {
+        std::string tables;
+        for (size_t index = 0; index < std::size(BULK_TABLES); ++index) {
+            tables += (tables.empty() ? "" : ", ") + trans.quote_name(stagingPrefix + bulkTable(index, normalizedHeaders_, uniqueHashes_).first);
+        }
+        trans.exec("DROP TABLE IF EXISTS " + tables);
+    };
+    {
+        auto cx = pool.acquire();
+        stagingPrefix = STAGING_PREFIX + std::to_string(cx->backendpid()) + "_";
+        pqxx::work setup(*cx);
+        // Created every run, so they always match the columns bulk inserts fill.
+        for (size_t index = 0; index < std::size(BULK_TABLES); ++index) {
+            auto [table, columns] = bulkTable(index, normalizedHeaders_, uniqueHashes_);
+            std::string staging = setup.quote_name(stagingPrefix + table);
+            setup.exec("DROP TABLE IF EXISTS " + staging);
+            setup.exec("CREATE UNLOGGED TABLE " + staging + " AS SELECT " + columns + " FROM " + table + " WITH NO DATA");
         }
+        setup.commit();
+    }
 
-        insert_trans.commit();
-        LOG_INFO << "Data successfully inserted into the database.";
+    // The dataset row is only written once the tables have been cleared, so its id is reserved up front.
+    auto coordinatorConnection = pool.acquire();
+    pqxx::work coordinator(*coordinatorConnection);
+    int datasetid = static_cast<int>(reserveIds(coordinator, "dataset", "datasetid", 1).front());
+
+    std::vector<EmailListView> parts = emailList->split(static_cast<int>(partitions));
+    try {
+        TaskGroup group(*WorkStealingPool::getInstance());
+        for (EmailListView& part : parts) {
+            group.run([&] {
+                auto cx = pool.acquire();
+                pqxx::work trans(*cx);
+                insertBulk(trans, datasetid, &part, stagingPrefix);
+                trans.commit();
+            });
+        }
+        group.wait();
+    } catch (...) {
+        coordinator.abort();
+        pqxx::work cleanup(*coordinatorConnection);
+        dropStaging(cleanup);
+        cleanup.commit();
+        throw;
+    }
+
+    // Cleared only now that every partition has committed. Ids are not restarted, as the partitions have
+    // already drawn theirs from the sequences.
+    clearDatabase(coordinator, false);
+    coordinator.exec("INSERT INTO dataset (datasetid, lastupdateddatetime, datasetname, datasetdescription) VALUES ($1, CURRENT_TIMESTAMP, $2, $3)",
+                     pqxx::params(datasetid, optionConfig_["datasetName"].get<std::string>(), optionConfig_["datasetDescription"].get<std::string>()));
+    for (size_t index = 0; index < std::size(BULK_TABLES); ++index) {
+        auto [table, columns] = bulkTable(index, normalizedHeaders_, uniqueHashes_);
+        coordinator.exec(std::string("INSERT INTO ") + table + " (" + columns + ") SELECT " + columns + " FROM " +
+                         coordinator.quote_name(stagingPrefix + table));
+    }
+    dropStaging(coordinator);
+    coordinator.commit();
+}
+
+namespace {
+    // Tables created when provisioning, if missing. Header keys are normalized into headername, see provisionSchema.
+    constexpr const char* PROVISIONED_TABLES[] = {
+        "dataset (datasetid serial PRIMARY KEY, datasetname text NOT NULL, datasetdescription text, lastupdateddatetime timestamp)",
+        "email (emailid serial PRIMARY KEY, datasetid integer NOT NULL, fileidentifier text, filedatetime timestamp, "
+        "ismimemultipart boolean NOT NULL DEFAULT false, uniquehash bigint)",
+        "headername (headernameid serial PRIMARY KEY, headername text NOT NULL UNIQUE)",
+        "emailheaderval (headerkeyid integer NOT NULL, headerval text)",
+        "emailpart (emailpartid serial PRIMARY KEY, emailid integer NOT NULL, partbody bytea)",
+        "emailpartheaderval (emailpartheaderkeyid integer NOT NULL, headerval text)",
+        "attributebag (emailid integer NOT NULL, attributekey text NOT NULL, attributeval bytea, datemodified timestamp)",
+    };
+
+    // Every lookup the reader and saver make by parent id, plus the header name and attribute key filters
+    // PostgresqlReader pushes down.
+    constexpr std::pair<const char*, const char*> PROVISIONED_INDEXES[] = {
+        {"dataset_datasetname", "dataset (datasetname)"},
+        {"email_datasetid_emailid", "email (datasetid, emailid)"},
+        {"emailheadername_emailid", "emailheadername (emailid)"},
+        {"emailheadername_headernameid", "emailheadername (headernameid, emailid)"},
+        {"emailheaderval_headerkeyid", "emailheaderval (headerkeyid)"},
+        {"emailpart_emailid", "emailpart (emailid, emailpartid)"},
+        {"emailpartheadername_emailpartid", "emailpartheadername (emailpartid)"},
+        {"emailpartheadername_headernameid", "emailpartheadername (headernameid, emailpartid)"},
+        {"emailpartheaderval_emailpartheaderkeyid", "emailpartheaderval (emailpartheaderkeyid)"},
+        {"attributebag_attributekey", "attributebag (attributekey, emailid)"},
+    };
+
+    // A header key table, the normalized table that replaces it and the columns of its rows.
+    struct HeaderKeyTable {
+        const char* view;
+        const char* table;
+        const char* id;
+        const char* owner;
+    };
+    constexpr HeaderKeyTable HEADER_KEY_TABLES[] = {
+        {"emailheaderkey", "emailheadername", "emailheaderkeyid", "emailid"},
+        {"emailpartheaderkey", "emailpartheadername", "emailpartheaderkeyid", "emailpartid"},
+    };
+}
+
+void PostgresqlSaver::provisionSchema(pqxx::work& trans) {
+    trans.exec("CREATE SCHEMA IF NOT EXISTS " + trans.quote_name(optionConfig_["schemaName"].get<std::string>()));
+    for (const char* table : PROVISIONED_TABLES) {
+        trans.exec(std::string("CREATE TABLE IF NOT EXISTS ") + table);
+    }
+
+    // Each header name is stored once in headername. The key tables keep only its id, and are replaced by
+    // views of the same name and columns, so queries written against the plain layout still work.
+    for (const HeaderKeyTable& keys : HEADER_KEY_TABLES) {
+        if (!trans.exec(std::string("SELECT to_regclass('") + keys.table + "') IS NULL")[0][0].as<bool>()) continue;
+        bool existing = trans.exec(std::string("SELECT to_regclass('") + keys.view + "') IS NOT NULL")[0][0].as<bool>();
+        if (existing) {
+            // Migrated in place. Renaming keeps the rows, their ids and the id sequence.
+            LOG_INFO << "Normalizing header names of " << keys.view << ".";
+            trans.exec(std::string("INSERT INTO headername (headername) SELECT DISTINCT coalesce(headerkey, '') FROM ") + keys.view +
+                       " ON CONFLICT (headername) DO NOTHING");
+            trans.exec(std::string("ALTER TABLE ") + keys.view + " RENAME TO " + keys.table);
+            trans.exec(std::string("ALTER TABLE ") + keys.table + " ADD COLUMN headernameid integer");
+            trans.exec(std::string("UPDATE ") + keys.table + " t SET headernameid = n.headernameid FROM headername n "
+                       "WHERE n.headername = coalesce(t.headerkey, '')");
+            trans.exec(std::string("ALTER TABLE ") + keys.table + " DROP COLUMN headerkey, ALTER COLUMN headernameid SET NOT NULL");
+        } else {
+            trans.exec(std::string("CREATE TABLE ") + keys.table + " (" + keys.id + " serial PRIMARY KEY, " + keys.owner +
+                       " integer NOT NULL, headernameid integer NOT NULL)");
+        }
+        trans.exec(std::string("CREATE VIEW ") + keys.view + " AS SELECT t." + keys.id + ", t." + keys.owner + ", n.headername AS headerkey FROM " +
+                   keys.table + " t JOIN headername n ON n.headernameid = t.headernameid");
+    }
+
+    for (const auto& [name, definition] : PROVISIONED_INDEXES) {
+        trans.exec(std::string("CREATE INDEX IF NOT EXISTS ") + name + " ON " + definition);
+    }
+}
+
+void PostgresqlSaver::compressColumns(pqxx::connection& cx) {
+    // Only applies to values written from now on. Needs PostgreSQL 14 built with lz4, otherwise pglz is kept.
+    try {
+        pqxx::work trans(cx);
+        trans.exec("ALTER TABLE emailpart ALTER COLUMN partbody SET COMPRESSION lz4");
+        trans.exec("ALTER TABLE attributebag ALTER COLUMN attributeval SET COMPRESSION lz4");
+        trans.commit();
+    } catch (const std::exception& e) {
+        LOG_WARNING << "PostgresqlSaver could not enable lz4 compression, keeping the default: " << e.what();
+    }
+}
+
+void PostgresqlSaver::resolveHeaderNames(pqxx::connection& cx, EmailListView* emailList) {
+    // Resolved and committed before any rows are written, so partitions writing in parallel only read the
+    // dictionary, and never wait on each other's uncommitted names.
+    std::set<std::string> names;
+    for (Email& email : *emailList) {
+        for (const std::string& key : email.getHeaderKeys()) {
+            if (!headerNameIds_.contains(key)) names.insert(key);
+        }
+        std::shared_ptr<EmailBody> body = email.getBody();
+        if (auto* mimeBody = dynamic_cast<MIMEMultipartBodies*>(body.get())) {
+            for (const MIMEMultipartPart& part : mimeBody->getMultipartParts()) {
+                for (const std::string& key : part.getHeaderKeys()) {
+                    if (!headerNameIds_.contains(key)) names.insert(key);
+                }
+            }
+        }
+    }
+    if (names.empty()) return;
+
+    pqxx::work trans(cx);
+    std::string rows;
+    for (const std::string& name : names) {
+        rows += (rows.empty() ? "(" : ", (") + trans.quote(name) + ")";
+    }
+    trans.exec("INSERT INTO headername (headername) VALUES " + rows + " ON CONFLICT (headername) DO NOTHING");
+    for (auto [id, name] : trans.stream<int, std::string>("SELECT headernameid, headername FROM headername")) {
+        headerNameIds_[name] = id;
+    }
+    trans.commit();
+}
+
+void PostgresqlSaver::prepareSchema(pqxx::connection& cx, bool delta) {
+    bool provision = optionConfig_.value("provisionSchema", false);
+    pqxx::work trans(cx);
+    if (provision) {
+        provisionSchema(trans);
+    }
+    // Emails are keyed by their content hash across saves, so it is written whenever the column exists. Only
+    // delta mode, which cannot work without it, and provisioning add it to databases that predate it, as
+    // altering the table needs more rights than a replace save and locks the table.
+    uniqueHashes_ = trans.exec("SELECT EXISTS (SELECT 1 FROM information_schema.columns WHERE table_schema = current_schema() "
+                               "AND table_name = 'email' AND column_name = 'uniquehash')")[0][0].as<bool>();
+    if (!uniqueHashes_ && (delta || provision)) {
+        trans.exec("ALTER TABLE email ADD COLUMN uniquehash bigint");
+        uniqueHashes_ = true;
+    }
+    // The indexes back the delta mode's lookups and upserts. A unique index cannot be built over duplicate
+    // attribute rows, which full saves never needed to avoid, so only modes that rely on it create it.
+    if (delta || provision) {
+        trans.exec("CREATE INDEX IF NOT EXISTS email_datasetid_uniquehash ON email (datasetid, uniquehash)");
+        trans.exec("CREATE UNIQUE INDEX IF NOT EXISTS attributebag_emailid_attributekey ON attributebag (emailid, attributekey)");
+    }
+    normalizedHeaders_ = trans.exec("SELECT to_regclass('emailheadername') IS NOT NULL")[0][0].as<bool>();
+    trans.commit();
+    if (provision) {
+        compressColumns(cx);
+    }
+}
+
+std::pair<size_t, size_t> PostgresqlSaver::saveDelta(pqxx::work& trans, int datasetid, EmailListView* emailList, bool bulk, const std::string& destination) {
+    // Emails saved before hashes were stored cannot be matched, and would all be saved a second time.
+    if (trans.exec("SELECT EXISTS (SELECT 1 FROM email WHERE uniquehash IS NULL AND datasetid = " + trans.quote(datasetid) + ")")[0][0].as<bool>()) {
+        throw std::runtime_error("dataset holds emails saved without a unique hash, save it once in replace mode before using delta mode");
+    }
+    std::unordered_map<int64_t, int64_t> saved; // uniquehash -> emailid
+    for (auto [uniqueHash, emailId] : trans.stream<int64_t, int64_t>(
+             "SELECT uniquehash, emailid FROM email WHERE uniquehash IS NOT NULL AND datasetid = " + trans.quote(datasetid))) {
+        saved.emplace(uniqueHash, emailId);
+    }
+
+    // Emails not saved before are written whole, on the same path as a full save. Of emails sharing a hash,
+    // only the first is written, so the dataset keeps one row per hash.
+    std::unordered_set<int64_t> inserted;
+    EmailListView newEmails = emailList->selectWhere([&](const Email& email) {
+        auto hash = static_cast<int64_t>(email.getUniqueHash());
+        return !saved.contains(hash) && inserted.insert(hash).second;
+    });
+    bulk ? insertBulk(trans, datasetid, &newEmails) : insertRowByRow(trans, datasetid, &newEmails);
+
+    // Emails already saved only have their attributes added or changed since they were last loaded or saved.
+    // Upserts do not depend on each other, so they are batched into one prepared statement with binary
+    // parameters instead of waiting out a round trip each. A batch never names the same row twice, as
+    // ON CONFLICT would reject it, so only the first email of each hash is upserted.
+    struct Upsert { int64_t emailid; std::string key; std::string value; };
+    std::vector<Upsert> batch;
+    batch.reserve(UPSERT_BATCH);
+    auto send = [&](const char* statement, std::span<const Upsert> rows) {
+        pqxx::params values;
+        for (const Upsert& row : rows) {
+            values.append(row.emailid);
+            values.append(row.key);
+            values.append(pqxx::binary_cast(row.value));
+        }
+        trans.exec_prepared(statement, values);
+    };
+    size_t upserted = 0;
+    std::unordered_set<int64_t> upsertedHashes;
+    for (Email& email : *emailList) {
+        auto it = saved.find(static_cast<int64_t>(email.getUniqueHash()));
+        if (it == saved.end() || !upsertedHashes.insert(it->first).second) continue;
+        for (const std::string& attributeKey : email.getDirtyAttributeKeys(destination)) {
+            batch.push_back({it->second, attributeKey, email.getAttributeValue(attributeKey)->serializeToString()});
+            ++upserted;
+            if (batch.size() == UPSERT_BATCH) {
+                send("upsert_attribute_batch", batch);
+                batch.clear();
+            }
+        }
+    }
+    for (const Upsert& row : batch) {
+        send("upsert_attribute", std::span(&row, 1));
+    }
+    return {newEmails.getSize(), upserted};
+}
+
+bool PostgresqlSaver::execute(EmailListView * emailList) {
+    LOG_INFO << "Writing to database";
+    SET_PLUGIN_STATE("RUNNING");
+    try {
+        auto started = std::chrono::steady_clock::now();
+        bool bulk = optionConfig_.value("bulkInsert", true);
+        size_t partitions = optionConfig_.value("connections", 1);
+        if (partitions > 1 && !bulk) {
+            LOG_WARNING << "PostgresqlSaver only writes in parallel with bulkInsert, using one connection.";
+            partitions = 1;
+        }
+        bool delta = optionConfig_.value("mode", "replace") == "delta";
+        std::string destination = PostgresqlConnectionPool::makeDestination(optionConfig_["databasePath"], optionConfig_["schemaName"], optionConfig_["datasetName"]);
+        if (delta && partitions > 1) {
+            LOG_WARNING << "PostgresqlSaver writes deltas in a single transaction, using one connection.";
+            partitions = 1;
+        }
+        // One more connection than partitions, for the coordinating transaction.
+        PostgresqlConnectionPool pool(optionConfig_["databasePath"], optionConfig_["schemaName"], partitions > 1 ? partitions + 1 : 1);
+        prepareSchema(*pool.acquire(), delta);
+        for (const auto& [name, definition] : PREPARED_STATEMENTS) {
+            auto named = [name](const auto& statement) { return std::string_view(statement.first) == name; };
+            auto normalized = std::ranges::find_if(NORMALIZED_STATEMENTS, named);
+            auto unhashed = std::ranges::find_if(UNHASHED_STATEMENTS, named);
+            if (normalizedHeaders_ && normalized != std::end(NORMALIZED_STATEMENTS)) {
+                pool.prepare(name, normalized->second);
+            } else if (!uniqueHashes_ && unhashed != std::end(UNHASHED_STATEMENTS)) {
+                pool.prepare(name, unhashed->second);
+            } else {
+                pool.prepare(name, definition);
+            }
+        }
+        if (delta) {
+            pool.prepare("upsert_attribute", upsertAttributeStatement(1));
+            pool.prepare("upsert_attribute_batch", upsertAttributeStatement(UPSERT_BATCH));
+        }
+        if (normalizedHeaders_) {
+            resolveHeaderNames(*pool.acquire(), emailList);
+        }
+
+        if (delta) {
+            auto cx = pool.acquire();
+            pqxx::work delta_trans(*cx);
+            int datasetid = getOrCreateDataset(delta_trans);
+            auto [inserted, upserted] = saveDelta(delta_trans, datasetid, emailList, bulk, destination);
+            delta_trans.commit();
+            LOG_INFO << "Delta saved: " << inserted << " new emails and " << upserted << " dirty attributes.";
+        } else if (partitions > 1) {
+            insertPartitioned(pool, emailList, partitions);
+        } else {
+            auto cx = pool.acquire();
+            pqxx::work insert_trans(*cx);
+            clearDatabase(insert_trans, true);
+            int datasetid = getOrCreateDataset(insert_trans);
+
+            bulk ? insertBulk(insert_trans, datasetid, emailList) : insertRowByRow(insert_trans, datasetid, emailList);
+
+            insert_trans.commit();
+        }
+        // The dataset now matches every email, so later delta saves into it only write what changes from here.
+        for (Email& email : *emailList) {
+            email.markAttributesSaved(destination);
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+        LOG_INFO << "Data successfully inserted into the database: " << emailList->getSize() << " emails in "
+                 << elapsed.count() << " ms (" << (bulk ? "COPY" : "row by row") << ", " << partitions << " connections).";
 
     }
     catch (std::exception& e) {
@@ -220,5 +791,3 @@ bool PostgresqlSaver::execute(EmailListView * emailList) {
     SET_PLUGIN_STATE("COMPLETE");
     return true;
 }
-
-
@@ -0,0 +1,29 @@
+#pragma once
+#include "PluginRunnableInterface.hpp"
+
+// SQLiteReader class implementing PluginInterface
+class SQLiteReader final : public PluginRunnableInterface {
+public:
+    explicit SQLiteReader(const std::string&);  // Constructor
+    ~SQLiteReader() override;  // Destructor
+
+    bool instantiateRecursive() override;
+    nlohmann::json printRecursiveInstanceTreeJson() override;
+
+    bool execute(EmailListView * emailList) override;
+
+    bool supportsBatchSource() const override { return true; }
+    bool executeAsSource(EmailListView* emailList, const BatchSink& sink) override;
+
+private:
+    struct Register {
+        Register() {
+            std::string name = "SQLiteReader";
+            LOG_DEBUG_VERBOSE << "Registering plugin " << name;
+            Plugins->registerPlugin(name, [](const std::string& instanceID) -> PluginInterface* {
+                return new SQLiteReader(instanceID);
+            });
+        }
+    };
+    static inline Register reg;
+};
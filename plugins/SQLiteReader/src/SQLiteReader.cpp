@@ -0,0 +1,196 @@
+#include "SQLiteReader.hpp"
+#include <limits>
+#include <vector>
+#include "Email.hpp"
+#include "EmailListView.hpp"
+#include "EmailRowAssembly.hpp"
+#include "Logger.hpp"
+#include "SqliteEmailDatabase.hpp"
+
+SQLiteReader::SQLiteReader(const std::string& instanceID) : PluginRunnableInterface(instanceID) {
+    pluginName_ = "SQLiteReader";
+    instanceID_ = instanceID;
+    optionSchema_ = R"(
+{
+  "$schema": "https://json-schema.org/draft/2020-12/schema",
+  "type": "object",
+  "properties": {
+    "databasePath": {
+      "type": "string",
+      "description": "The SQLite database file written by SQLiteSaver."
+    },
+    "datasetName": {
+      "type": "string",
+      "description": "The name of the dataset."
+    },
+    "batchSize": {
+      "type": "integer",
+      "minimum": 0,
+      "default": 0,
+      "description": "Number of emails read, built and inserted per batch. 0 reads the whole dataset at once."
+    }
+  },
+  "required": ["databasePath", "datasetName"],
+  "additionalProperties": false
+}
+    )"_json;
+    inputAttributes_ = {};
+    generatedAttributes_ = {};
+    SET_PLUGIN_STATE("LOADED");
+}
+
+SQLiteReader::~SQLiteReader() = default;
+
+bool SQLiteReader::instantiateRecursive() {
+    SET_PLUGIN_STATE("READY");
+    return true;
+}
+
+nlohmann::json SQLiteReader::printRecursiveInstanceTreeJson() {
+    nlohmann::json node;
+    try {
+        node["instanceID"] = instanceID_;
+        node["createFunc"] = Plugins->getCreateFuncForInstance(instanceID_) ? Plugins->getCreateFuncForInstance(instanceID_) : "Not Loaded";
+        node["state"]     = getState();
+        node["schema"]       = !optionSchema_.empty()? optionSchema_ : "";
+        node["config"]       = !optionConfig_.empty() ? optionConfig_ : "";
+    } catch (std::exception& e) {
+        LOG_ERROR << e.what();
+    }
+    return node;
+}
+
+using namespace EmailRowAssembly;
+
+namespace {
+    // One statement per table, compiled once and run once per batch. Child tables are read by emailid range,
+    // rows of other datasets within the range are skipped when merging.
+    struct Statements {
+        SqliteEmailDatabase::Statement emails;
+        SqliteEmailDatabase::Statement headers;
+        SqliteEmailDatabase::Statement attributes;
+        SqliteEmailDatabase::Statement parts;
+        SqliteEmailDatabase::Statement partHeaders;
+
+        explicit Statements(SqliteEmailDatabase& db) :
+            emails(db.prepare("SELECT emailid, ismimemultipart, uniquehash FROM email WHERE datasetid = ?1 AND emailid > ?2 ORDER BY emailid LIMIT ?3")),
+            headers(db.prepare("SELECT k.emailid, k.headerkey, v.headerval FROM emailheaderkey k "
+                               "JOIN emailheaderval v ON v.headerkeyid = k.emailheaderkeyid "
+                               "WHERE k.emailid BETWEEN ?1 AND ?2 ORDER BY k.emailid, k.emailheaderkeyid")),
+            attributes(db.prepare("SELECT emailid, attributekey, attributeval FROM attributebag WHERE emailid BETWEEN ?1 AND ?2 ORDER BY emailid")),
+            parts(db.prepare("SELECT emailid, emailpartid, partbody FROM emailpart WHERE emailid BETWEEN ?1 AND ?2 ORDER BY emailid, emailpartid")),
+            partHeaders(db.prepare("SELECT k.emailpartid, k.headerkey, v.headerval FROM emailpartheaderkey k "
+                                   "JOIN emailpart p ON p.emailpartid = k.emailpartid "
+                                   "LEFT JOIN emailpartheaderval v ON v.emailpartheaderkeyid = k.emailpartheaderkeyid "
+                                   "WHERE p.emailid BETWEEN ?1 AND ?2 ORDER BY p.emailid, k.emailpartid, k.emailpartheaderkeyid")) {}
+    };
+
+    // Reads up to limit emails (-1 for all) of the dataset after lastId, advancing lastId past them.
+    std::vector<Email> readBatch(Statements& statements, int64_t datasetid, const std::string& destination, int64_t& lastId, int64_t limit) {
+        std::vector<PendingEmail> pending;
+        std::vector<std::optional<int64_t>> storedHashes;
+        statements.emails.bind(1, datasetid).bind(2, lastId).bind(3, limit);
+        while (statements.emails.step()) {
+            PendingEmail& entry = pending.emplace_back();
+            entry.emailid = statements.emails.getInt(0);
+            entry.email.setIsMIMEMultipart(statements.emails.getInt(1) != 0);
+            storedHashes.push_back(statements.emails.isNull(2) ? std::nullopt : std::optional(statements.emails.getInt(2)));
+        }
+        statements.emails.reset();
+        if (pending.empty()) return {};
+        int64_t firstId = pending.front().emailid;
+        lastId = pending.back().emailid;
+
+        auto bindRange = [&](SqliteEmailDatabase::Statement& statement) -> SqliteEmailDatabase::Statement& {
+            return statement.bind(1, firstId).bind(2, lastId);
+        };
+
+        size_t cursor = 0;
+        for (auto& headers = bindRange(statements.headers); headers.step();) {
+            if (PendingEmail* entry = seek(pending, cursor, &PendingEmail::emailid, headers.getInt(0))) {
+                entry->email.setHeader(headers.getString(1), headers.getString(2));
+            }
+        }
+        statements.headers.reset();
+
+        cursor = 0;
+        for (auto& attributes = bindRange(statements.attributes); attributes.step();) {
+            PendingEmail* entry = seek(pending, cursor, &PendingEmail::emailid, attributes.getInt(0));
+            if (!entry) continue;
+            if (auto attribute = AttributeBagRegistry::deserializeAttribute(attributes.getString(2))) {
+                entry->email.insertAttribute(attributes.getString(1), std::move(attribute));
+            }
+        }
+        statements.attributes.reset();
+
+        cursor = 0;
+        for (auto& parts = bindRange(statements.parts); parts.step();) {
+            if (PendingEmail* entry = seek(pending, cursor, &PendingEmail::emailid, parts.getInt(0))) {
+                entry->parts.push_back({parts.getInt(1), parts.getString(2), {}});
+            }
+        }
+        statements.parts.reset();
+
+        PartHeaderMerger partHeaderMerger(pending);
+        for (auto& partHeaders = bindRange(statements.partHeaders); partHeaders.step();) {
+            std::optional<std::string> value = partHeaders.isNull(2) ? std::nullopt : std::optional(partHeaders.getString(2));
+            if (!partHeaderMerger.add(partHeaders.getInt(0), partHeaders.getString(1), std::move(value))) break;
+        }
+        statements.partHeaders.reset();
+
+        std::vector<Email> emails;
+        emails.reserve(pending.size());
+        for (size_t i = 0; i < pending.size(); ++i) {
+            assembleBody(pending[i]);
+            Email& newEmail = pending[i].email;
+            // SQLiteSaver stores each email's hash, so it is only recomputed for rows written without one.
+            storedHashes[i] ? newEmail.setUniqueHash(static_cast<size_t>(*storedHashes[i])) : newEmail.generateUniqueHash();
+            newEmail.markAttributesSaved(destination); // Matches the dataset, so a delta save into it has nothing to write yet.
+            emails.push_back(std::move(newEmail));
+        }
+        return emails;
+    }
+}
+
+bool SQLiteReader::execute(EmailListView * emailList) {
+    return executeAsSource(emailList, {});
+}
+
+bool SQLiteReader::executeAsSource(EmailListView* emailList, const BatchSink& sink) {
+    LOG_INFO << "Reading from SQLite database.";
+    SET_PLUGIN_STATE("RUNNING");
+    bool status = true;
+    try {
+        int64_t batchSize = optionConfig_.value("batchSize", 0);
+        std::string path = optionConfig_["databasePath"];
+        std::string destination = SqliteEmailDatabase::makeDestination(path, optionConfig_["datasetName"]);
+        SqliteEmailDatabase db(path);
+        auto dataset = db.prepare("SELECT datasetid FROM dataset WHERE datasetname = ?1");
+        if (!dataset.bind(1, optionConfig_["datasetName"].get<std::string>()).step()) {
+            LOG_ERROR << "SQLiteReader: dataset " << optionConfig_["datasetName"].get<std::string>() << " not found.";
+            SET_PLUGIN_STATE("FAILED");
+            return false;
+        }
+        int64_t datasetid = dataset.getInt(0);
+
+        BatchDelivery delivery(emailList, sink, "SQLiteReader");
+        Statements statements(db);
+        db.exec("BEGIN"); // Every batch reads the same snapshot of the file.
+        int64_t lastId = std::numeric_limits<int64_t>::min();
+        for (;;) {
+            std::vector<Email> emails = readBatch(statements, datasetid, destination, lastId, batchSize > 0 ? batchSize : -1);
+            if (emails.empty()) break;
+            delivery.deliver(std::move(emails));
+            if (batchSize == 0) break;
+        }
+        status = delivery.finish();
+        db.exec("COMMIT");
+        LOG_INFO << "Emails successfully read from the SQLite database.";
+    } catch (const std::exception& e) {
+        LOG_ERROR << "Exception occurred during SQLite read: " << e.what();
+        SET_PLUGIN_STATE("FAILED");
+        return false;
+    }
+    status ? SET_PLUGIN_STATE("COMPLETE") : SET_PLUGIN_STATE("FAILED");
+    return status;
+}
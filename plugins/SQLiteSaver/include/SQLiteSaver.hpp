@@ -0,0 +1,32 @@
+#pragma once
+#include "PluginRunnableInterface.hpp"
+
+class Email;
+class SqliteEmailDatabase;
+
+// SQLiteSaver class implementing PluginInterface
+class SQLiteSaver final : public PluginRunnableInterface {
+public:
+    explicit SQLiteSaver(const std::string&);  // Constructor
+    ~SQLiteSaver() override;  // Destructor
+
+    bool instantiateRecursive() override;
+    nlohmann::json printRecursiveInstanceTreeJson() override;
+
+    bool execute(EmailListView * emailList) override;
+
+private:
+    int64_t getOrCreateDataset(SqliteEmailDatabase& db);
+    std::pair<size_t, size_t> writeEmails(SqliteEmailDatabase& db, int64_t datasetid, EmailListView* emailList, bool delta, const std::string& destination);
+
+    struct Register {
+        Register() {
+            std::string name = "SQLiteSaver";
+            LOG_DEBUG_VERBOSE << "Registering plugin " << name;
+            Plugins->registerPlugin(name, [](const std::string& instanceID) -> PluginInterface* {
+                return new SQLiteSaver(instanceID);
+            });
+        }
+    };
+    static inline Register reg;
+};
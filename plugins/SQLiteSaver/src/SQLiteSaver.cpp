@@ -0,0 +1,228 @@
+#include "SQLiteSaver.hpp"
+#include <chrono>
+#include <unordered_map>
+#include "Email.hpp"
+#include "EmailBody.hpp"
+#include "EmailListView.hpp"
+#include "Logger.hpp"
+#include "SqliteEmailDatabase.hpp"
+
+SQLiteSaver::SQLiteSaver(const std::string& instanceID) : PluginRunnableInterface(instanceID) {
+    pluginName_ = "SQLiteSaver";
+    instanceID_ = instanceID;
+    optionSchema_ = R"(
+{
+  "$schema": "https://json-schema.org/draft/2020-12/schema",
+  "type": "object",
+  "properties": {
+    "databasePath": {
+      "type": "string",
+      "description": "The SQLite database file, created if missing."
+    },
+    "datasetName": {
+      "type": "string",
+      "description": "The name of the dataset."
+    },
+    "datasetDescription": {
+      "type": "string",
+      "description": "A description of the dataset."
+    },
+    "mode": {
+      "type": "string",
+      "enum": ["replace", "delta"],
+      "default": "replace",
+      "description": "replace clears every table and writes all emails. delta keeps what is saved, adds new emails and upserts changed attributes."
+    },
+    "transactionSize": {
+      "type": "integer",
+      "minimum": 0,
+      "default": 0,
+      "description": "Number of emails written per transaction. 0 writes everything in one transaction."
+    }
+  },
+  "required": ["databasePath", "datasetName", "datasetDescription"],
+  "additionalProperties": false
+}
+    )"_json;
+    inputAttributes_ = {};
+    generatedAttributes_ = {};
+    SET_PLUGIN_STATE("LOADED");
+}
+
+SQLiteSaver::~SQLiteSaver() = default;
+
+bool SQLiteSaver::instantiateRecursive() {
+    SET_PLUGIN_STATE("READY");
+    return true;
+}
+
+nlohmann::json SQLiteSaver::printRecursiveInstanceTreeJson() {
+    nlohmann::json node;
+    try {
+        node["instanceID"] = instanceID_;
+        node["createFunc"] = Plugins->getCreateFuncForInstance(instanceID_) ? Plugins->getCreateFuncForInstance(instanceID_) : "Not Loaded";
+        node["state"]     = getState();
+        node["schema"]       = !optionSchema_.empty()? optionSchema_ : "";
+        node["config"]       = !optionConfig_.empty() ? optionConfig_ : "";
+    } catch (std::exception& e) {
+        LOG_ERROR << e.what();
+    }
+    return node;
+}
+
+int64_t SQLiteSaver::getOrCreateDataset(SqliteEmailDatabase& db) {
+    std::string datasetName = optionConfig_["datasetName"];
+    auto select = db.prepare("SELECT datasetid FROM dataset WHERE datasetname = ?1");
+    if (select.bind(1, datasetName).step()) {
+        return select.getInt(0);
+    }
+    db.prepare("INSERT INTO dataset (lastupdateddatetime, datasetname, datasetdescription) VALUES (CURRENT_TIMESTAMP, ?1, ?2)")
+        .bind(1, datasetName)
+        .bind(2, optionConfig_["datasetDescription"].get<std::string>())
+        .execute();
+    return db.getLastInsertId();
+}
+
+namespace {
+    // Every statement a save runs per row, compiled once. Ids of inserted rows are read from the rowid.
+    struct Statements {
+        SqliteEmailDatabase::Statement email;
+        SqliteEmailDatabase::Statement headerKey;
+        SqliteEmailDatabase::Statement headerValue;
+        SqliteEmailDatabase::Statement part;
+        SqliteEmailDatabase::Statement partHeaderKey;
+        SqliteEmailDatabase::Statement partHeaderValue;
+        SqliteEmailDatabase::Statement upsertAttribute;
+
+        explicit Statements(SqliteEmailDatabase& db) :
+            email(db.prepare("INSERT INTO email (datasetid, fileidentifier, filedatetime, ismimemultipart, uniquehash) VALUES (?1, ?2, CURRENT_TIMESTAMP, ?3, ?4)")),
+            headerKey(db.prepare("INSERT INTO emailheaderkey (emailid, headerkey) VALUES (?1, ?2)")),
+            headerValue(db.prepare("INSERT INTO emailheaderval (headerkeyid, headerval) VALUES (?1, ?2)")),
+            part(db.prepare("INSERT INTO emailpart (emailid, partbody) VALUES (?1, ?2)")),
+            partHeaderKey(db.prepare("INSERT INTO emailpartheaderkey (emailpartid, headerkey) VALUES (?1, ?2)")),
+            partHeaderValue(db.prepare("INSERT INTO emailpartheaderval (emailpartheaderkeyid, headerval) VALUES (?1, ?2)")),
+            // Only rewrites a value that changed. A new email's attributes never conflict.
+            upsertAttribute(db.prepare("INSERT INTO attributebag (emailid, attributekey, attributeval, datemodified) VALUES (?1, ?2, ?3, CURRENT_TIMESTAMP) "
+                                       "ON CONFLICT (emailid, attributekey) DO UPDATE SET attributeval = excluded.attributeval, datemodified = excluded.datemodified "
+                                       "WHERE attributebag.attributeval IS NOT excluded.attributeval")) {}
+    };
+
+    // Returns the emailid of the new row.
+    int64_t insertEmail(SqliteEmailDatabase& db, Statements& statements, int64_t datasetid, Email& email) {
+        statements.email.bind(1, datasetid)
+            .bind(2, email.getAttributeValue("File identifier")->toString())
+            .bind(3, int64_t{email.getIsMIMEMultipart()})
+            .bind(4, static_cast<int64_t>(email.getUniqueHash()))
+            .execute();
+        int64_t emailid = db.getLastInsertId();
+
+        for (const auto& [key, value] : email.getHeader()) {
+            statements.headerKey.bind(1, emailid).bind(2, key).execute();
+            statements.headerValue.bind(1, db.getLastInsertId()).bind(2, value).execute();
+        }
+
+        std::shared_ptr<EmailBody> body = email.getBody();
+        if (auto* standardBody = dynamic_cast<StandardEmailBody*>(body.get())) {
+            statements.part.bind(1, emailid).bindBlob(2, standardBody->getAllBodyData()).execute();
+        } else if (auto* mimeBody = dynamic_cast<MIMEMultipartBodies*>(body.get())) {
+            for (MIMEMultipartPart& multipart : mimeBody->getMultipartParts()) {
+                statements.part.bind(1, emailid).bindBlob(2, multipart.getBody()).execute();
+                int64_t emailpartid = db.getLastInsertId();
+                for (const auto& [key, values] : multipart.getHeader()) {
+                    statements.partHeaderKey.bind(1, emailpartid).bind(2, key).execute();
+                    int64_t emailpartheaderkeyid = db.getLastInsertId();
+                    for (const std::string& value : values) {
+                        statements.partHeaderValue.bind(1, emailpartheaderkeyid).bind(2, value).execute();
+                    }
+                }
+            }
+        } else {
+            LOG_ERROR << "Unknown EmailBody type";
+        }
+
+        for (const std::string& attributeKey : email.getAttributeKeys()) {
+            statements.upsertAttribute.bind(1, emailid).bind(2, attributeKey)
+                .bindBlob(3, email.getAttributeValue(attributeKey)->serializeToString()).execute();
+        }
+        return emailid;
+    }
+}
+
+std::pair<size_t, size_t> SQLiteSaver::writeEmails(SqliteEmailDatabase& db, int64_t datasetid, EmailListView* emailList, bool delta, const std::string& destination) {
+    std::unordered_map<int64_t, int64_t> saved; // uniquehash -> emailid
+    if (delta) {
+        auto existing = db.prepare("SELECT uniquehash, emailid FROM email WHERE uniquehash IS NOT NULL AND datasetid = ?1");
+        existing.bind(1, datasetid);
+        while (existing.step()) {
+            saved.emplace(existing.getInt(0), existing.getInt(1));
+        }
+    }
+
+    Statements statements(db);
+    size_t transactionSize = optionConfig_.value("transactionSize", 0);
+    size_t inserted = 0;
+    size_t upserted = 0;
+    size_t pending = 0;
+    for (Email& email : *emailList) {
+        auto it = saved.find(static_cast<int64_t>(email.getUniqueHash()));
+        if (it == saved.end()) {
+            int64_t emailid = insertEmail(db, statements, datasetid, email);
+            if (delta) {
+                saved.emplace(static_cast<int64_t>(email.getUniqueHash()), emailid); // Later emails with the same hash update this row.
+            }
+            ++inserted;
+        } else {
+            for (const std::string& attributeKey : email.getDirtyAttributeKeys(destination)) {
+                statements.upsertAttribute.bind(1, it->second).bind(2, attributeKey)
+                    .bindBlob(3, email.getAttributeValue(attributeKey)->serializeToString()).execute();
+                ++upserted;
+            }
+        }
+        // Commits are appends to the WAL, so splitting a large save only bounds how far the log grows.
+        if (transactionSize > 0 && ++pending >= transactionSize) {
+            db.exec("COMMIT; BEGIN IMMEDIATE");
+            pending = 0;
+        }
+    }
+    return {inserted, upserted};
+}
+
+bool SQLiteSaver::execute(EmailListView * emailList) {
+    LOG_INFO << "Writing to SQLite database";
+    SET_PLUGIN_STATE("RUNNING");
+    try {
+        auto started = std::chrono::steady_clock::now();
+        bool delta = optionConfig_.value("mode", "replace") == "delta";
+        std::string path = optionConfig_["databasePath"];
+        std::string destination = SqliteEmailDatabase::makeDestination(path, optionConfig_["datasetName"]);
+        SqliteEmailDatabase db(path);
+
+        db.exec("BEGIN IMMEDIATE");
+        std::pair<size_t, size_t> written;
+        try {
+            if (!delta) {
+                db.exec("DELETE FROM dataset; DELETE FROM email; DELETE FROM emailheaderkey; DELETE FROM emailheaderval; DELETE FROM emailpart; "
+                        "DELETE FROM emailpartheaderkey; DELETE FROM emailpartheaderval; DELETE FROM attributebag;");
+            }
+            written = writeEmails(db, getOrCreateDataset(db), emailList, delta, destination);
+            db.exec("COMMIT");
+        } catch (...) {
+            if (db.isInTransaction()) db.exec("ROLLBACK");
+            throw;
+        }
+
+        // The dataset now matches every email, so later delta saves into it only write what changes from here.
+        for (Email& email : *emailList) {
+            email.markAttributesSaved(destination);
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+        LOG_INFO << "SQLiteSaver wrote " << written.first << " emails and upserted " << written.second << " attributes in "
+                 << elapsed.count() << " ms.";
+    } catch (const std::exception& e) {
+        LOG_ERROR << "Exception occurred during SQLite save: " << e.what();
+        SET_PLUGIN_STATE("FAILED");
+        return false;
+    }
+    SET_PLUGIN_STATE("COMPLETE");
+    return true;
+}
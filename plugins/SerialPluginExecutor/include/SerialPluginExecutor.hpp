@@ -13,6 +13,7 @@
 
 #include "PluginExecutorInterface.hpp"
 #include "PluginRegistry.hpp"
+#include "PluginRunnableInterface.hpp"
 
 class SerialPluginExecutor final : public PluginExecutorInterface {
 public:
@@ -41,6 +42,15 @@ public:
     bool executeOne(EmailListView *, std::string) override;
 
 private:
+    // Each plugin's state by instance ID, recorded with checkpoints.
+    nlohmann::json getPluginStates();
+    // Executes one plugin, through the result cache if enabled.
+    bool runPlugin(PluginInterface& plugin, EmailListView* emailList);
+    // Runs the plugins in turn, but pushes batches through each run of consecutive batch-capable plugins.
+    bool executeStreaming(EmailListView* emailList);
+    // Pipelines batches of the list through the given plugins, each stage on its own batch.
+    bool streamBatches(EmailListView* emailList, const std::vector<PluginRunnableInterface*>& stages);
+
     struct Register {
         Register() {
             std::string name = "SerialPluginExecutor";
@@ -1,8 +1,15 @@
+#include <atomic>
+#include <functional>
+
 #include "SerialPluginExecutor.hpp"
+#include "CheckpointManager.hpp"
+#include "GlobalConfigManager.hpp"
 #include "Logger.hpp"
 #include "EmailListView.hpp"
 #include "PluginInterface.hpp"
 #include "PluginRegistry.hpp"
+#include "ResultCache.hpp"
+#include "WorkStealingPool.hpp"
 
 SerialPluginExecutor::SerialPluginExecutor(const std::string& instanceID) : PluginExecutorInterface(instanceID) {
     pluginName_ = "RootPluginExecutor";
@@ -38,6 +45,27 @@ SerialPluginExecutor::SerialPluginExecutor(const std::string& instanceID) : Plug
                 ],
                 "additionalProperties": false
             }
+        },
+        "streaming": {
+            "type": "boolean",
+            "default": false,
+            "description": "Push batches of emails through consecutive plugins that support batches, rather than running each plugin over the whole list in turn."
+        },
+        "batch_size": {
+            "type": "integer",
+            "minimum": 1,
+            "default": 256,
+            "description": "Number of emails per batch in streaming mode."
+        },
+        "use_result_cache": {
+            "type": "boolean",
+            "default": false,
+            "description": "Skip emails a plugin already processed with the same config and inputs, reusing the attributes it generated then. Only applies to plugins that declare their generated attributes."
+        },
+        "checkpoint": {
+            "type": "boolean",
+            "default": false,
+            "description": "Periodically checkpoint storage between plugins, and resume from the last checkpoint if the workflow is restarted. Only for the top-level executor, and not in streaming mode."
         }
     },
     "required": [
@@ -71,20 +99,207 @@ bool SerialPluginExecutor::execute(EmailListView * emailList) {
 
     bool status = true;
     SET_PLUGIN_STATE("RUNNING");
+    if (optionConfig_.value("streaming", false)) {
+        status = executeStreaming(emailList);
+        status ? SET_PLUGIN_STATE("COMPLETE") : SET_PLUGIN_STATE("FAILED");
+        return status;
+    }
+
+    // Checkpoints cover the whole of storage, so they are only taken by the top-level executor.
+    EmailStorage* storage = optionConfig_.value("checkpoint", false) ? GlobalConfigManager::getInstance()->getEmailListPointer() : nullptr;
+    std::string workflowKey = storage ? CheckpointManager::makeWorkflowKey(optionConfig_) : "";
+    nlohmann::json resumedStates;
+    size_t resumeFrom = storage ? CheckpointManager::getInstance()->resume(workflowKey, *storage, resumedStates) : 0;
+    if (resumeFrom > 0) {
+        emailList->commitInserts(); // A full view picks up the restored emails.
+    }
+
+    size_t completed = 0;
     for (auto a : managedPlugins_) {
         if (a.second) {
-            status &= a.second->execute(emailList);
+            if (completed < resumeFrom) {
+                LOG_INFO << "SPE Skipping plugin " << a.first << ", completed before the checkpoint.";
+                // Restored as recorded, which for a plugin completed before the checkpoint is COMPLETE.
+                std::string state = resumedStates.value(a.first, std::string("COMPLETE"));
+                if (state == "COMPLETE") a.second->setExecutionState("RUNNING");
+                a.second->setExecutionState(state);
+                ++completed;
+                continue;
+            }
+            status &= runPlugin(*a.second, emailList);
             emailList->commitInserts();
+            ++completed;
+            if (storage && status) {
+                CheckpointManager::getInstance()->pluginsCompleted(workflowKey, completed, *storage, getPluginStates());
+            }
         } else {
             LOG_ERROR << "SPE Plugin being asked for doesn't exist!";
             status &= false;
             return status;
         }
     }
+    if (storage && status) {
+        CheckpointManager::getInstance()->finish(workflowKey);
+    }
     SET_PLUGIN_STATE("COMPLETE");
     return status;
 }
 
+nlohmann::json SerialPluginExecutor::getPluginStates() {
+    nlohmann::json states = nlohmann::json::object();
+    for (auto a : managedPlugins_) {
+        if (a.second) states[a.first] = a.second->getState();
+    }
+    return states;
+}
+
+bool SerialPluginExecutor::runPlugin(PluginInterface& plugin, EmailListView* emailList) {
+    if (optionConfig_.value("use_result_cache", false)) {
+        return ResultCache::getInstance()->executeCached(plugin, emailList);
+    }
+    return plugin.execute(emailList);
+}
+
+bool SerialPluginExecutor::executeStreaming(EmailListView* emailList) {
+    bool status = true;
+    std::vector<PluginInterface*> plugins;
+    for (auto a : managedPlugins_) {
+        if (!a.second) {
+            LOG_ERROR << "SPE Plugin being asked for doesn't exist!";
+            return false;
+        }
+        plugins.push_back(a.second.get());
+    }
+    auto batchable = [&plugins](size_t index) -> PluginRunnableInterface* {
+        auto* runnable = dynamic_cast<PluginRunnableInterface*>(plugins[index]);
+        return runnable && runnable->supportsBatches() ? runnable : nullptr;
+    };
+
+    std::vector<PluginRunnableInterface*> stages;
+    for (size_t index = 0; index < plugins.size(); ++index) {
+        if (PluginRunnableInterface* stage = batchable(index)) {
+            stages.push_back(stage);
+            continue;
+        }
+        // A whole-list plugin is a barrier: everything streamed before it must have finished.
+        if (!stages.empty()) {
+            status &= streamBatches(emailList, stages);
+            stages.clear();
+        }
+        // A source feeds the streaming plugins right after it batch by batch, while it is still producing.
+        // Those plugins are run over the emails that were already in the list afterwards.
+        auto* source = dynamic_cast<PluginRunnableInterface*>(plugins[index]);
+        std::vector<PluginRunnableInterface*> downstream;
+        while (source && source->supportsBatchSource() && index + 1 < plugins.size() && batchable(index + 1)) {
+            downstream.push_back(batchable(++index));
+        }
+        if (downstream.empty()) {
+            status &= runPlugin(*plugins[index], emailList);
+            emailList->commitInserts();
+            continue;
+        }
+        EmailListView existing = emailList->slice(0, emailList->getRowCount(), emailList->getRangeOffsets());
+        for (PluginRunnableInterface* stage : downstream) {
+            stage->setExecutionState("RUNNING");
+        }
+        bool sourced = source->executeAsSource(emailList, [&downstream](std::span<Email*> batch) {
+            for (PluginRunnableInterface* stage : downstream) {
+                if (!stage->executeBatch(batch)) return false;
+            }
+            return true;
+        });
+        emailList->commitInserts();
+        if (!sourced) {
+            // A failed stage cannot be told apart from a failed source, and FAILED cannot go back to RUNNING.
+            for (PluginRunnableInterface* stage : downstream) {
+                stage->setExecutionState("FAILED");
+            }
+            status = false;
+            continue;
+        }
+        status &= streamBatches(&existing, downstream);
+    }
+    if (!stages.empty()) {
+        status &= streamBatches(emailList, stages);
+    }
+    return status;
+}
+
+bool SerialPluginExecutor::streamBatches(EmailListView* emailList, const std::vector<PluginRunnableInterface*>& stages) {
+    size_t batchSize = std::max(1, optionConfig_.value("batch_size", static_cast<int>(PluginRunnableInterface::DEFAULT_BATCH_SIZE)));
+    size_t totalRows = emailList->getRowCount();
+    size_t batches = (totalRows + batchSize - 1) / batchSize;
+    for (PluginRunnableInterface* stage : stages) {
+        stage->setExecutionState("RUNNING");
+    }
+    if (batches == 0) {
+        for (PluginRunnableInterface* stage : stages) {
+            stage->setExecutionState("COMPLETE");
+        }
+        return true;
+    }
+    const std::vector<size_t> rangeOffsets = emailList->getRangeOffsets();
+
+    // Stage s may take batch b once stage s-1 has finished b (list order through the chain) and stage s has
+    // finished b-1 (one batch at a time per plugin instance). Each task counts down what it is waiting on.
+    std::vector<std::atomic<int>> waiting(stages.size() * batches);
+    for (size_t stage = 0; stage < stages.size(); ++stage) {
+        for (size_t batch = 0; batch < batches; ++batch) {
+            waiting[stage * batches + batch].store((stage > 0) + (batch > 0));
+        }
+    }
+    std::atomic<bool> failed = false;
+    std::vector<size_t> finished(stages.size(), 0); // Batches each stage ran successfully, only touched by its own tasks.
+
+    TaskGroup group(*WorkStealingPool::getInstance());
+    std::function<void(size_t, size_t)> runStage = [&](size_t stage, size_t batch) {
+        for (;;) {
+            if (!failed.load()) {
+                size_t offset = batch * batchSize;
+                EmailListView view = emailList->slice(offset, std::min(batchSize, totalRows - offset), rangeOffsets);
+                std::vector<Email*> emails;
+                emails.reserve(batchSize);
+                for (Email& email : view) {
+                    emails.push_back(&email);
+                }
+                try {
+                    if (stages[stage]->executeBatch(emails)) {
+                        ++finished[stage];
+                    } else {
+                        LOG_ERROR << "Streaming plugin " << stages[stage]->getInstanceID() << " failed on batch " << batch << ".";
+                        failed.store(true);
+                    }
+                } catch (const std::exception& e) {
+                    LOG_ERROR << "Streaming plugin " << stages[stage]->getInstanceID() << " threw: " << e.what();
+                    failed.store(true);
+                }
+            }
+            // Successors are released even after a failure, so every queued stage drains and the wait returns.
+            if (batch + 1 < batches && waiting[stage * batches + batch + 1].fetch_sub(1) == 1) {
+                group.run([&runStage, stage, batch] { runStage(stage, batch + 1); });
+            }
+            // The same batch moves on to the next plugin on this thread, while it is still in cache.
+            if (stage + 1 < stages.size() && waiting[(stage + 1) * batches + batch].fetch_sub(1) == 1) {
+                ++stage;
+                continue;
+            }
+            return;
+        }
+    };
+    group.run([&runStage] { runStage(0, 0); });
+    try {
+        group.wait();
+    } catch (const std::exception& e) {
+        LOG_ERROR << "Streaming batch threw: " << e.what();
+        failed.store(true);
+    }
+    for (size_t stage = 0; stage < stages.size(); ++stage) {
+        stages[stage]->setExecutionState(finished[stage] == batches ? "COMPLETE" : "FAILED");
+    }
+    LOG_DEBUG_VERBOSE << "SerialPluginExecutor streamed " << batches << " batches through " << stages.size() << " plugins.";
+    return !failed.load();
+}
+
 void SerialPluginExecutor::clearAllInstances() {
     for (auto a : managedPlugins_) {
         auto* executor = dynamic_cast<PluginExecutorInterface*>(a.second.get());
@@ -194,7 +409,7 @@ bool SerialPluginExecutor::executeOne(EmailListView * emailList, std::string ins
         }
         if (a.first == instanceID) {
             LOG_DEBUG_VERBOSE << "SPE Executing plugin: " << a.first << " as any prior plugins are COMPLETE.";
-            status &= a.second->execute(emailList);
+            status &= runPlugin(*a.second, emailList);
             emailList->commitInserts();
             return status;
         }
@@ -105,7 +105,13 @@ void ArgumentParser::generateNewGlobalConfig() {
 {
     "log_dir" : "logs",
     "hostname": "127.0.0.1",
-    "port": 8080
+    "port": 8080,
+    "worker_threads": 0,
+    "pin_worker_threads": false,
+    "result_cache_dir": "cache",
+    "result_cache_max_mb": 0,
+    "checkpoint_dir": "checkpoints",
+    "checkpoint_interval_seconds": 300
 }
     )"_json;
     MyFile << dummyConfig.dump(4);
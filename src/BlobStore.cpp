@@ -0,0 +1,128 @@
+#include "BlobStore.hpp"
+#include <fcntl.h>
+#include <fstream>
+#include <ranges>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Logger.hpp"
+#include "StableHash.hpp"
+
+// Purge expired weak references every so many interns, so the map does not grow with dead entries.
+static constexpr size_t PURGE_INTERVAL = 4096;
+
+Blob::Blob(std::string bytes) : bytes_(std::move(bytes)) {
+    hash_ = StableHash::fnv1a(StableHash::FNV_OFFSET, view());
+}
+
+Blob::Blob(const char* mapping, size_t length) : mapping_(mapping), mappingLength_(length) {
+    hash_ = StableHash::fnv1a(StableHash::FNV_OFFSET, view());
+}
+
+Blob::Blob(std::string_view bytes, size_t hash, std::shared_ptr<const void> mappingOwner)
+    : mapping_(bytes.data()), mappingLength_(bytes.size()), hash_(hash), mappingOwner_(std::move(mappingOwner)) {}
+
+Blob::~Blob() {
+    if (mapping_ && !mappingOwner_) {
+        munmap(const_cast<char*>(mapping_), mappingLength_);
+    }
+}
+
+std::string_view Blob::view() const {
+    return mapping_ ? std::string_view(mapping_, mappingLength_) : std::string_view(bytes_);
+}
+
+size_t Blob::size() const {
+    return mapping_ ? mappingLength_ : bytes_.size();
+}
+
+size_t Blob::hash() const {
+    return hash_;
+}
+
+bool Blob::isMapped() const {
+    return mapping_ != nullptr;
+}
+
+BlobStore* BlobStore::getInstance() {
+    static BlobStore instance;
+    return &instance;
+}
+
+BlobHandle BlobStore::intern(std::string bytes) {
+    return insertOrFind(std::make_unique<Blob>(std::move(bytes)));
+}
+
+BlobHandle BlobStore::internFile(const std::filesystem::path& path, bool mapFile) {
+    if (mapFile) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Error: Unable to open file: " + path.string());
+        }
+        struct stat st{};
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (mapping != MAP_FAILED) {
+                return insertOrFind(std::make_unique<Blob>(static_cast<const char*>(mapping), st.st_size));
+            }
+            LOG_WARNING << "mmap failed for " << path.string() << ", falling back to a heap copy.";
+        } else {
+            close(fd); // Empty files cannot be mapped, read them as normal.
+        }
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Error: Unable to open file: " + path.string());
+    }
+    return intern(std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>()));
+}
+
+BlobHandle BlobStore::internMapped(std::string_view bytes, size_t hash, std::shared_ptr<const void> mappingOwner) {
+    return insertOrFind(std::make_unique<Blob>(bytes, hash, std::move(mappingOwner)));
+}
+
+BlobHandle BlobStore::insertOrFind(std::unique_ptr<Blob> blob) {
+    std::lock_guard lock(mtx_);
+    if (++internsSincePurge_ >= PURGE_INTERVAL) {
+        std::erase_if(blobs_, [](const auto& entry) { return entry.second.expired(); });
+        internsSincePurge_ = 0;
+    }
+
+    auto [first, last] = blobs_.equal_range(blob->hash());
+    for (auto it = first; it != last; ++it) {
+        if (BlobHandle existing = it->second.lock(); existing && existing->view() == blob->view()) {
+            return existing; // Identical content already stored, the new copy is released here.
+        }
+    }
+
+    BlobHandle handle(std::move(blob));
+    blobs_.emplace(handle->hash(), handle);
+    return handle;
+}
+
+void BlobStore::purgeExpired() {
+    std::lock_guard lock(mtx_);
+    std::erase_if(blobs_, [](const auto& entry) { return entry.second.expired(); });
+    internsSincePurge_ = 0;
+}
+
+size_t BlobStore::getBlobCount() {
+    std::lock_guard lock(mtx_);
+    size_t count = 0;
+    for (const auto& entry : blobs_ | std::views::values) {
+        if (!entry.expired()) ++count;
+    }
+    return count;
+}
+
+size_t BlobStore::getStoredBytes() {
+    std::lock_guard lock(mtx_);
+    size_t total = 0;
+    for (const auto& entry : blobs_ | std::views::values) {
+        if (BlobHandle blob = entry.lock()) total += blob->size();
+    }
+    return total;
+}
@@ -0,0 +1,143 @@
+#include "CheckpointManager.hpp"
+#include <fstream>
+#include "Email.hpp"
+#include "EmailListView.hpp"
+#include "EmailSegmentFile.hpp"
+#include "EmailStorage.hpp"
+#include "GlobalConfigManager.hpp"
+#include "Logger.hpp"
+#include "StableHash.hpp"
+
+namespace {
+    // Writes to a temporary file first, so readers only ever see a complete file.
+    bool writeFileAtomically(const std::filesystem::path& path, const std::string& contents) {
+        std::filesystem::path temporary = path;
+        temporary += ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+            if (!out.flush()) return false;
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+        return !error;
+    }
+}
+
+CheckpointManager* CheckpointManager::getInstance() {
+    static CheckpointManager instance(
+        GlobalConfigManager::getInstance()->getGlobalConfigValue<std::string>("checkpoint_dir", "checkpoints"),
+        std::chrono::seconds(GlobalConfigManager::getInstance()->getGlobalConfigValue<int>("checkpoint_interval_seconds", 300)));
+    return &instance;
+}
+
+CheckpointManager::CheckpointManager(std::filesystem::path directory, std::chrono::seconds interval)
+    : directory_(std::move(directory)), interval_(interval) {}
+
+CheckpointManager::~CheckpointManager() {
+    std::lock_guard lock(mtx_);
+    waitForWrite();
+}
+
+std::string CheckpointManager::makeWorkflowKey(const nlohmann::json& config) {
+    return std::to_string(StableHash::fnv1a(StableHash::FNV_OFFSET, config.dump()));
+}
+
+void CheckpointManager::waitForWrite() {
+    if (pendingWrite_.valid()) pendingWrite_.get();
+}
+
+size_t CheckpointManager::resume(const std::string& workflowKey, EmailStorage& storage, nlohmann::json& pluginStates) {
+    std::lock_guard lock(mtx_);
+    waitForWrite();
+    lastCheckpoint_ = std::chrono::steady_clock::now(); // The interval counts from the start of the run.
+    std::ifstream progressFile(directory_ / (workflowKey + ".progress.json"));
+    if (!progressFile) return 0;
+
+    nlohmann::json progress;
+    try {
+        progressFile >> progress;
+    } catch (const std::exception& e) {
+        LOG_ERROR << "Unreadable checkpoint progress for workflow " << workflowKey << ": " << e.what();
+        return 0;
+    }
+    if (storage.getSize() > 0) {
+        LOG_WARNING << "Not resuming workflow " << workflowKey << " from its checkpoint, as storage already holds emails.";
+        return 0;
+    }
+
+    EmailListView emails = storage.getFullView();
+    if (!EmailSegmentFile::load(directory_ / progress.value("snapshot", ""), emails)) {
+        LOG_ERROR << "Unable to restore the checkpoint of workflow " << workflowKey << ", starting from scratch.";
+        return 0;
+    }
+    emails.commitInserts();
+    size_t completed = progress.value("completed", size_t{0});
+    pluginStates = progress.value("plugin_states", nlohmann::json::object());
+    LOG_INFO << "Resumed workflow " << workflowKey << " with " << storage.getSize() << " emails after "
+             << completed << " completed plugins.";
+    return completed;
+}
+
+void CheckpointManager::pluginsCompleted(const std::string& workflowKey, size_t completed, EmailStorage& storage, const nlohmann::json& pluginStates) {
+    std::lock_guard lock(mtx_);
+    auto now = std::chrono::steady_clock::now();
+    if (interval_.count() <= 0 || now - lastCheckpoint_ < interval_) return;
+    lastCheckpoint_ = now;
+    waitForWrite(); // One checkpoint in flight at a time, which also keeps them in order.
+
+    // Captured here, at the plugin boundary, as the next plugin will start changing emails. Only headers are
+    // copied: bodies and attribute values are shared, and plugins replace them rather than modify them.
+    std::vector<Email> emails;
+    {
+        EmailListView view = storage.getFullView();
+        emails.reserve(view.getSize());
+        for (const Email& email : view) {
+            emails.push_back(email.shallowCopy());
+        }
+    }
+
+    std::string snapshotName = workflowKey + "." + std::to_string(completed) + ".storage";
+    nlohmann::json progress = {
+        {"completed", completed},
+        {"snapshot", snapshotName},
+        {"plugin_states", pluginStates}
+    };
+    pendingWrite_ = std::async(std::launch::async, [this, workflowKey, snapshotName, progress, emails = std::move(emails)] {
+        std::error_code error;
+        std::filesystem::create_directories(directory_, error);
+        // The snapshot goes first: progress must never name a snapshot that is not fully written.
+        std::optional<size_t> written;
+        try {
+            written = EmailSegmentFile::write(directory_ / snapshotName, emails);
+        } catch (const std::exception& e) {
+            LOG_ERROR << "Writing checkpoint " << snapshotName << " threw: " << e.what();
+        }
+        if (!written || !writeFileAtomically(directory_ / (workflowKey + ".progress.json"), progress.dump(4))) {
+            LOG_ERROR << "Failed to write checkpoint " << snapshotName << ".";
+            return;
+        }
+        removeSnapshots(workflowKey, snapshotName);
+        LOG_INFO << "Checkpointed workflow " << workflowKey << " after " << progress["completed"] << " plugins ("
+                 << *written << " emails).";
+    });
+}
+
+void CheckpointManager::finish(const std::string& workflowKey) {
+    std::lock_guard lock(mtx_);
+    waitForWrite();
+    std::error_code error;
+    std::filesystem::remove(directory_ / (workflowKey + ".progress.json"), error);
+    removeSnapshots(workflowKey, "");
+}
+
+void CheckpointManager::removeSnapshots(const std::string& workflowKey, const std::string& keep) const {
+    std::error_code error;
+    if (!std::filesystem::is_directory(directory_, error)) return;
+    for (const auto& entry : std::filesystem::directory_iterator(directory_, error)) {
+        std::string name = entry.path().filename().string();
+        if (name != keep && name.starts_with(workflowKey + ".") && name.ends_with(".storage")) {
+            std::filesystem::remove(entry.path(), error);
+        }
+    }
+}
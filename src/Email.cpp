@@ -1,9 +1,13 @@
 #include "Email.hpp"
+#include <algorithm>
+#include <ranges>
+#include "StableHash.hpp"
 
 Email::Email() : body(nullptr), isMIMEMultipart(false), uniqueHash(0) {}
 
-Email::Email(const Email& other) :
-    header(other.header), isMIMEMultipart(other.getIsMIMEMultipart()), uniqueHash(other.getUniqueHash()) {
+Email::Email(const Email& other) : isMIMEMultipart(other.getIsMIMEMultipart()), uniqueHash(other.getUniqueHash()) {
+    std::shared_lock lock(other.mtx_);
+    header = other.header;
     if (other.body) {
         if (auto *standardBody = dynamic_cast<StandardEmailBody *>(other.body.get())) {
             body = std::make_unique<StandardEmailBody>(*standardBody);
@@ -15,21 +19,53 @@ Email::Email(const Email& other) :
     }
 
     for (const auto &[key, value]: other.attribute_bag) {
-        attribute_bag[key] = std::unique_ptr<AttributeBagValueInterface>(value->clone());
+        attribute_bag[key] = std::shared_ptr<AttributeBagValueInterface>(value->clone());
     }
+    attributeRevision = other.attributeRevision;
+    changedAttributes = other.changedAttributes;
+    savedRevisions = other.savedRevisions;
+}
+
+Email Email::shallowCopy() const {
+    Email copy;
+    copy.isMIMEMultipart = isMIMEMultipart;
+    copy.uniqueHash = uniqueHash;
+    std::shared_lock lock(mtx_);
+    copy.header = header;
+    copy.body = body;
+    for (const auto& [key, value] : attribute_bag) {
+        copy.attribute_bag.emplace(key, value);
+    }
+    return copy;
 }
 
+Email::Email(Email&& other) noexcept :
+    header(std::move(other.header)),
+    body(std::move(other.body)),
+    attribute_bag(std::move(other.attribute_bag)),
+    attributeRevision(other.attributeRevision),
+    changedAttributes(std::move(other.changedAttributes)),
+    savedRevisions(std::move(other.savedRevisions)),
+    isMIMEMultipart(other.isMIMEMultipart),
+    uniqueHash(other.uniqueHash) {}
+
 Email& Email::operator=(Email&& other) noexcept {
     if (this != &other) {
         header = std::move(other.header);
         attribute_bag = std::move(other.attribute_bag);
         body = std::move(other.body);
+        attributeRevision = other.attributeRevision;
+        changedAttributes = std::move(other.changedAttributes);
+        savedRevisions = std::move(other.savedRevisions);
+        isMIMEMultipart = other.isMIMEMultipart;
+        uniqueHash = other.uniqueHash;
     }
     return *this;
 }
 
 nlohmann::json Email::toJson() {
     nlohmann::json emailJson;
+    std::shared_lock lock(mtx_);
     try {
         emailJson["uniqueHash"] = getUniqueHash();
 
@@ -41,6 +77,10 @@ nlohmann::json Email::toJson() {
 
         emailJson["attributes"] = nlohmann::json::object();
         for (const auto& [key, valuePtr] : attribute_bag) {
+            if (auto* blob = dynamic_cast<AttributeBagBlob*>(valuePtr.get())) { // Reference raw bytes rather than copying them out.
+                emailJson["attributes"][key] = "AttributeBagBlob:<" + std::to_string(blob->getBlob()->size()) + " bytes, hash " + std::to_string(blob->getBlob()->hash()) + ">";
+                continue;
+            }
             emailJson["attributes"][key] = valuePtr ? valuePtr->serializeToString() : nullptr;
         }
     } catch (const std::exception& e) {
@@ -50,14 +90,17 @@ nlohmann::json Email::toJson() {
 }
 
 void Email::setHeader(const std::string& key, const std::string& value) {
+    std::unique_lock lock(mtx_);
     header[key] = value;
 }
 
 std::map<std::string, std::string> Email::getHeader() const {
+    std::shared_lock lock(mtx_);
     return header;
 }
 
 std::vector<std::string> Email::getHeaderKeys() const {
+    std::shared_lock lock(mtx_);
     std::vector<std::string> keys;
     for (const auto& imap : header) {
         keys.push_back(imap.first);
@@ -66,6 +109,7 @@ std::vector<std::string> Email::getHeaderKeys() const {
 }
 
 std::vector<std::string> Email::getHeaderValues() const {
+    std::shared_lock lock(mtx_);
     std::vector<std::string> values;
     for (const auto &imap : header) {
         values.push_back(imap.second);
@@ -74,33 +118,62 @@ std::vector<std::string> Email::getHeaderValues() const {
 }
 
 void Email::setBody(std::unique_ptr<EmailBody> newBody) {
+    std::unique_lock lock(mtx_);
     body = std::move(newBody);
 }
 
-EmailBody* Email::getBody() const {
-    return body.get();
+std::shared_ptr<EmailBody> Email::getBody() const {
+    std::shared_lock lock(mtx_);
+    return body;
 }
 
 std::vector<std::string> Email::getAttributeKeys() const {
+    std::shared_lock lock(mtx_);
     std::vector<std::string> attributeKeys;
     for (const auto &imap : attribute_bag)
         attributeKeys.push_back(imap.first);
     return attributeKeys;
 }
 
-std::vector<AttributeBagValueInterface*> Email::getAttributeValues() const {
-    std::vector<AttributeBagValueInterface*> attributeValues;
+std::vector<std::shared_ptr<AttributeBagValueInterface>> Email::getAttributeValues() const {
+    std::shared_lock lock(mtx_);
+    std::vector<std::shared_ptr<AttributeBagValueInterface>> attributeValues;
     for (const auto& imap : attribute_bag)
-        attributeValues.push_back(imap.second.get());
+        attributeValues.push_back(imap.second);
     return attributeValues;
 }
 
-AttributeBagValueInterface* Email::getAttributeValue(const std::string& key) const {
-    return attribute_bag.at(key).get();
+std::shared_ptr<AttributeBagValueInterface> Email::getAttributeValue(const std::string& key) const {
+    std::shared_lock lock(mtx_);
+    return attribute_bag.at(key);
 }
 
 void Email::insertAttribute(const std::string& key, std::unique_ptr<AttributeBagValueInterface> attribute) {
+    std::unique_lock lock(mtx_);
     attribute_bag[key] = std::move(attribute);
+    changedAttributes[key] = ++attributeRevision;
+}
+
+std::vector<std::string> Email::getDirtyAttributeKeys(const std::string& destination) const {
+    std::shared_lock lock(mtx_);
+    std::vector<std::string> keys;
+    auto saved = savedRevisions.find(destination);
+    if (saved == savedRevisions.end()) {
+        for (const auto& imap : attribute_bag)
+            keys.push_back(imap.first);
+        return keys;
+    }
+    for (const auto& [key, revision] : changedAttributes) {
+        if (revision > saved->second) keys.push_back(key);
+    }
+    return keys;
+}
+
+void Email::markAttributesSaved(const std::string& destination) {
+    std::unique_lock lock(mtx_);
+    savedRevisions[destination] = attributeRevision;
+    uint64_t oldest = std::ranges::min(savedRevisions | std::views::values);
+    std::erase_if(changedAttributes, [oldest](const auto& changed) { return changed.second <= oldest; });
 }
 
 void Email::setIsMIMEMultipart(bool value) {
@@ -112,14 +185,22 @@ bool Email::getIsMIMEMultipart() const {
 }
 
 void Email::generateUniqueHash() {
-    std::hash<std::string> hasher;
-    uniqueHash = hasher(getAttributeValue("File bytes")->toString());
+    std::shared_ptr<AttributeBagValueInterface> fileBytes = getAttributeValue("File bytes");
+    if (auto* blob = dynamic_cast<AttributeBagBlob*>(fileBytes.get())) { // Blobs are hashed once, on interning.
+        uniqueHash = blob->getBlob()->hash();
+        return;
+    }
+    uniqueHash = StableHash::fnv1a(StableHash::FNV_OFFSET, fileBytes->toString());
 }
 
 size_t Email::getUniqueHash() const {
     return uniqueHash;
 }
 
+void Email::setUniqueHash(size_t hash) {
+    uniqueHash = hash;
+}
+
 bool Email::operator==(const Email& other) const {
     return uniqueHash == other.uniqueHash;
-}
\ No newline at end of file
+}
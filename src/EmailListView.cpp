@@ -1,60 +1,378 @@
 #include "EmailListView.hpp"
 #include "EmailStorage.hpp"
+#include <algorithm>
+#include <bit>
 #include <iterator>
 #include <shared_mutex>
+#include <utility>
+
+namespace {
+
+// Bits one range costs, past which a bitmap over the rows it would skip is cheaper.
+constexpr size_t RANGE_BITS = sizeof(EmailRowRange) * 8;
+// Selections with fewer ranges than this are small enough to leave as they are.
+constexpr size_t MIN_MASKED_RANGES = 1024;
+
+void appendBits(std::vector<uint64_t>& mask, size_t& bits, bool value, size_t count) {
+    mask.resize((bits + count + 63) / 64, 0);
+    if (value) {
+        for (size_t i = bits; i < bits + count; ++i) {
+            mask[i / 64] |= uint64_t{1} << (i % 64);
+        }
+    }
+    bits += count;
+}
+
+bool testBit(const std::vector<uint64_t>& mask, size_t bit) {
+    return (mask[bit / 64] >> (bit % 64)) & 1;
+}
+
+// Bits [from, from + count) of mask, or nothing if mask is empty (every row selected).
+std::vector<uint64_t> copyBits(const std::vector<uint64_t>& mask, size_t from, size_t count) {
+    std::vector<uint64_t> copy;
+    if (mask.empty()) return copy;
+    size_t bits = 0;
+    copy.reserve((count + 63) / 64);
+    for (size_t i = from; i < from + count; ++i) {
+        appendBits(copy, bits, testBit(mask, i), 1);
+    }
+    return copy;
+}
+
+// Appends the rows of one selection to another, in order.
+void appendSelection(EmailRowSelection& into, const EmailRowSelection& from) {
+    if (from.ranges.empty()) return;
+    if (!into.mask.empty() || !from.mask.empty()) {
+        if (into.mask.empty()) { // Every row selected so far becomes a set bit.
+            size_t rows = 0;
+            for (const EmailRowRange& range : into.ranges) rows += range.end - range.begin;
+            appendBits(into.mask, into.maskBits, true, rows);
+        }
+        if (from.mask.empty()) {
+            size_t rows = 0;
+            for (const EmailRowRange& range : from.ranges) rows += range.end - range.begin;
+            appendBits(into.mask, into.maskBits, true, rows);
+        } else {
+            for (size_t bit = 0; bit < from.maskBits; ++bit) {
+                appendBits(into.mask, into.maskBits, testBit(from.mask, bit), 1);
+            }
+        }
+    }
+    for (const EmailRowRange& range : from.ranges) {
+        if (!into.ranges.empty() && into.ranges.back().shard == range.shard && into.ranges.back().end == range.begin) {
+            into.ranges.back().end = range.end;
+        } else {
+            into.ranges.push_back(range);
+        }
+    }
+}
+
+// Switches a selection from ranges to spans plus a mask, if that is smaller. Ranges separated by fewer
+// rows than a range costs in bits are merged into one span, so the mask never costs more than the ranges it replaces.
+void maskIfFragmented(EmailRowSelection& selection) {
+    const std::vector<EmailRowRange>& ranges = selection.ranges;
+    size_t spans = 1;
+    size_t spannedRows = ranges[0].end - ranges[0].begin;
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        const EmailRowRange& previous = ranges[i - 1];
+        const EmailRowRange& range = ranges[i];
+        if (range.shard == previous.shard && range.begin >= previous.end && range.begin - previous.end < RANGE_BITS) {
+            spannedRows += range.end - previous.end;
+        } else {
+            ++spans;
+            spannedRows += range.end - range.begin;
+        }
+    }
+    if ((spans * RANGE_BITS + spannedRows) >= ranges.size() * RANGE_BITS) return;
+
+    EmailRowSelection masked;
+    masked.ranges.reserve(spans);
+    masked.mask.reserve((spannedRows + 63) / 64);
+    for (const EmailRowRange& range : ranges) {
+        EmailRowRange* last = masked.ranges.empty() ? nullptr : &masked.ranges.back();
+        if (last && range.shard == last->shard && range.begin >= last->end && range.begin - last->end < RANGE_BITS) {
+            appendBits(masked.mask, masked.maskBits, false, range.begin - last->end);
+            last->end = range.end;
+        } else {
+            masked.ranges.push_back(range);
+        }
+        appendBits(masked.mask, masked.maskBits, true, range.end - range.begin);
+    }
+    selection = std::move(masked);
+}
+
+} // namespace
+
+EmailListView::Iterator::Iterator(EmailStorage* storage, const std::vector<EmailRowRange>* ranges,
+                                  const std::vector<uint64_t>* mask, size_t rangeIndex)
+    : storage_(storage),
+    ranges_(ranges),
+    mask_(mask && !mask->empty() ? mask : nullptr),
+    rangeIndex_(rangeIndex) {
+    enterRange();
+}
+
+void EmailListView::Iterator::enterRange() {
+    while (rangeIndex_ < ranges_->size()) {
+        const EmailRowRange& range = (*ranges_)[rangeIndex_];
+        shard_ = storage_->shards_[range.shard].get();
+        for (row_ = range.begin; row_ < range.end; ++row_) {
+            if (!shard_->isRemoved(row_) && isSelected()) {
+                rangeEnd_ = range.end;
+                return;
+            }
+        }
+        nextRange();
+    }
+    // Past the last range, matches end().
+    shard_ = nullptr;
+    row_ = 0;
+    rangeEnd_ = 0;
+}
 
 // Constructor
 /**
  *
  * @param storage
- * @param s
- * @param e
+ * @param ranges Shard row ranges covered by the view, iterated in order.
+ * @param fullView Whether the view should track everything committed to storage.
+ * @param mask Selected rows of ranges, one bit per row in order, or empty to select all of them.
  */
-EmailListView::EmailListView(EmailStorage* storage, size_t startIndex, size_t endIndex)
+EmailListView::EmailListView(EmailStorage* storage, std::vector<EmailRowRange> ranges, bool fullView,
+                             std::vector<uint64_t> mask)
     : storage_(storage),
-    startIndex_(startIndex),
-    endIndex_(endIndex) {}
+    ranges_(std::move(ranges)),
+    mask_(std::move(mask)),
+    fullView_(fullView) {
+    if (storage_) storage_->openViews_.fetch_add(1);
+}
+
+EmailListView::EmailListView(EmailListView&& other) noexcept
+    : storage_(std::exchange(other.storage_, nullptr)),
+    ranges_(std::move(other.ranges_)),
+    mask_(std::move(other.mask_)),
+    fullView_(other.fullView_),
+    narrowed_(other.narrowed_),
+    insertQueue_(std::move(other.insertQueue_)) {}
 
 EmailListView::~EmailListView() {
     commitInserts();
+    if (storage_) storage_->openViews_.fetch_sub(1);
 }
 
-std::vector<Email>::iterator EmailListView::begin() { return storage_->emails_.begin() + startIndex_; }
+EmailIterator EmailListView::begin() { return Iterator(storage_, &ranges_, &mask_, 0); }
 
-std::vector<Email>::iterator EmailListView::end() { return storage_->emails_.begin() + endIndex_; }
+EmailIterator EmailListView::end() { return Iterator(storage_, &ranges_, &mask_, ranges_.size()); }
 
 size_t EmailListView::getSize() const {
-    return (endIndex_ > startIndex_) ? (endIndex_ - startIndex_) : 0;
+    if (!storage_) return 0;
+    size_t total = 0;
+    size_t offset = 0;
+    for (const EmailRowRange& range : ranges_) {
+        const EmailStorage::Shard& shard = *storage_->shards_[range.shard];
+        if (mask_.empty()) {
+            total += shard.countLive(range.begin, range.end);
+            continue;
+        }
+        for (size_t row = range.begin; row < range.end; ++row, ++offset) {
+            if (testBit(mask_, offset) && !shard.isRemoved(row)) ++total;
+        }
+    }
+    return total;
+}
+
+size_t EmailListView::getRowCount() const {
+    size_t total = 0;
+    for (const EmailRowRange& range : ranges_) {
+        total += range.end - range.begin;
+    }
+    return total;
+}
+
+std::vector<size_t> EmailListView::getRangeOffsets() const {
+    std::vector<size_t> offsets;
+    offsets.reserve(ranges_.size());
+    size_t offset = 0;
+    for (const EmailRowRange& range : ranges_) {
+        offsets.push_back(offset);
+        offset += range.end - range.begin;
+    }
+    return offsets;
+}
+
+EmailListView EmailListView::slice(size_t offset, size_t count, const std::vector<size_t>& rangeOffsets) const {
+    std::vector<EmailRowRange> sliceRanges;
+    size_t sliceRows = 0;
+    // The last range starting at or before offset is the one containing it.
+    size_t rangeIndex = std::upper_bound(rangeOffsets.begin(), rangeOffsets.end(), offset) - rangeOffsets.begin();
+    rangeIndex = rangeIndex > 0 ? rangeIndex - 1 : 0;
+    for (; count > 0 && rangeIndex < ranges_.size(); ++rangeIndex) {
+        const EmailRowRange& range = ranges_[rangeIndex];
+        size_t begin = range.begin + (offset > rangeOffsets[rangeIndex] ? offset - rangeOffsets[rangeIndex] : 0);
+        if (begin >= range.end) continue;
+        size_t taken = std::min(count, range.end - begin);
+        sliceRanges.push_back({range.shard, begin, begin + taken});
+        sliceRows += taken;
+        count -= taken;
+    }
+    return EmailListView(storage_, std::move(sliceRanges), false, copyBits(mask_, offset, sliceRows));
 }
 
 std::vector<EmailListView> EmailListView::split(int numParts) {
-    size_t totalSize = getSize();
+    // Split on row counts, removed rows included, so no tombstone bitmap has to be scanned.
+    size_t totalSize = getRowCount();
     if (numParts <= 0 || totalSize == 0) return {};
 
     std::vector<EmailListView> segments;
     size_t segmentSize = totalSize / numParts;
     size_t remainder = totalSize % numParts;
 
-    size_t segmentStart = startIndex_;
+    // Walk the ranges once, cutting them wherever a segment fills up.
+    size_t rangeIndex = 0;
+    size_t row = ranges_.empty() ? 0 : ranges_[0].begin;
+    size_t offset = 0;
     for (int i = 0; i < numParts; ++i) {
-        size_t segmentEnd = segmentStart + segmentSize + (i < remainder ? 1 : 0);
-        segments.emplace_back(EmailListView(storage_, segmentStart, segmentEnd));
-        segmentStart = segmentEnd;
+        size_t wanted = segmentSize + (static_cast<size_t>(i) < remainder ? 1 : 0);
+        std::vector<EmailRowRange> segmentRanges;
+        while (wanted > 0 && rangeIndex < ranges_.size()) {
+            const EmailRowRange& range = ranges_[rangeIndex];
+            size_t taken = std::min(wanted, range.end - row);
+            if (taken > 0) {
+                segmentRanges.push_back({range.shard, row, row + taken});
+                row += taken;
+                wanted -= taken;
+            }
+            if (row >= range.end && ++rangeIndex < ranges_.size()) {
+                row = ranges_[rangeIndex].begin;
+            }
+        }
+        size_t segmentRows = segmentSize + (static_cast<size_t>(i) < remainder ? 1 : 0) - wanted;
+        segments.emplace_back(EmailListView(storage_, std::move(segmentRanges), false, copyBits(mask_, offset, segmentRows)));
+        offset += segmentRows;
     }
 
     return segments;
 }
 
-void EmailListView::insertEmail(const Email& email) {
-    insertQueue_.push(email);
+void EmailListView::insertEmail(Email&& email) {
+    insertQueue_.emplace_back(std::move(email));
+}
+
+bool EmailListView::removeEmail(const Iterator& position) {
+    if (!storage_) return false;
+    return storage_->shards_[position.shard()]->markRemoved(position.row());
+}
+
+void EmailListView::appendRow(EmailRowSelection& selection, size_t shard, size_t row) {
+    std::vector<EmailRowRange>& ranges = selection.ranges;
+    EmailRowRange* last = ranges.empty() ? nullptr : &ranges.back();
+    if (selection.mask.empty()) {
+        if (last && last->shard == shard && last->end == row) {
+            ++last->end;
+            return;
+        }
+        ranges.push_back({shard, row, row + 1});
+        // Checked as the range count doubles, so the scans add up to a constant per range.
+        if (ranges.size() >= MIN_MASKED_RANGES && std::has_single_bit(ranges.size())) {
+            maskIfFragmented(selection);
+        }
+        return;
+    }
+    // Masked: extend the last span over short gaps, start a new one past long gaps or on another shard.
+    if (last && last->shard == shard && last->end <= row && row - last->end < RANGE_BITS) {
+        appendBits(selection.mask, selection.maskBits, false, row - last->end);
+        last->end = row + 1;
+    } else {
+        ranges.push_back({shard, row, row + 1});
+    }
+    appendBits(selection.mask, selection.maskBits, true, 1);
+}
+
+EmailListView EmailListView::select(EmailRowSelection selection) const {
+    return EmailListView(storage_, std::move(selection.ranges), false, std::move(selection.mask));
+}
+
+EmailRowSelection EmailListView::getSelection() const {
+    return {ranges_, mask_, mask_.empty() ? 0 : getRowCount()};
+}
+
+void EmailListView::narrowToSlices(std::map<size_t, std::pair<size_t, EmailRowSelection>> slices) {
+    const std::vector<size_t> rangeOffsets = getRangeOffsets();
+    size_t rowCount = getRowCount();
+    EmailRowSelection merged;
+    size_t position = 0;
+    for (auto& [offset, slice] : slices) {
+        if (offset > position) appendSelection(merged, this->slice(position, offset - position, rangeOffsets).getSelection());
+        appendSelection(merged, slice.second);
+        position = std::max(position, offset + slice.first);
+    }
+    if (rowCount > position) appendSelection(merged, slice(position, rowCount - position, rangeOffsets).getSelection());
+    narrowTo(std::move(merged));
+}
+
+void EmailListView::narrowTo(EmailRowSelection selection) {
+    ranges_ = std::move(selection.ranges);
+    mask_ = std::move(selection.mask);
+    narrowed_ = true;
+    fullView_ = false; // A full view would otherwise widen back to all of storage on its next commit.
+}
+
+void EmailListView::absorbSlice(EmailListView& slice, size_t baseRowCount) {
+    for (Email& email : slice.insertQueue_) {
+        insertQueue_.emplace_back(std::move(email));
+    }
+    slice.insertQueue_.clear();
+    if (slice.narrowed_) {
+        std::map<size_t, std::pair<size_t, EmailRowSelection>> narrowed;
+        narrowed[0] = {baseRowCount, slice.getSelection()};
+        narrowToSlices(std::move(narrowed));
+        return;
+    }
+    if (fullView_) return; // Picks up the committed rows on its next commit anyway.
+
+    size_t maskBits = mask_.empty() ? 0 : getRowCount();
+    size_t skipped = 0;
+    for (const EmailRowRange& range : slice.ranges_) {
+        size_t length = range.end - range.begin;
+        if (skipped + length <= baseRowCount) {
+            skipped += length;
+            continue;
+        }
+        size_t begin = range.begin + (baseRowCount > skipped ? baseRowCount - skipped : 0);
+        skipped += length;
+        if (!mask_.empty()) appendBits(mask_, maskBits, true, range.end - begin);
+        if (!ranges_.empty() && ranges_.back().shard == range.shard && ranges_.back().end == begin) {
+            ranges_.back().end = range.end;
+        } else {
+            ranges_.push_back({range.shard, begin, range.end});
+        }
+    }
 }
 
 void EmailListView::commitInserts() {
-    while (!insertQueue_.empty()) {
-        storage_->insertEmail(insertQueue_.front());
-        insertQueue_.pop();
+    if (!storage_) return; // Moved-from view.
+    if (insertQueue_.empty() && !fullView_) return;
+
+    if (!insertQueue_.empty()) {
+        EmailRowRange inserted = storage_->insertEmails(std::move(insertQueue_));
+        insertQueue_.clear();
+        if (!fullView_) {
+            // Partial views only gain the rows they inserted themselves.
+            if (!mask_.empty()) {
+                size_t maskBits = getRowCount();
+                appendBits(mask_, maskBits, true, inserted.end - inserted.begin);
+            }
+            if (!ranges_.empty() && ranges_.back().shard == inserted.shard && ranges_.back().end == inserted.begin) {
+                ranges_.back().end = inserted.end;
+            } else {
+                ranges_.push_back(inserted);
+            }
+            return;
+        }
     }
-    storage_->refresh_full_view_size_(&startIndex_, &endIndex_);
+
+    std::shared_lock lock(storage_->storageMutex_);
+    ranges_ = storage_->fullRanges();
 }
 
 nlohmann::json EmailListView::getSimpleEmailJsonList() {
@@ -62,9 +380,9 @@ nlohmann::json EmailListView::getSimpleEmailJsonList() {
 
     if (!storage_) return jsonEmails;
 
-    for (size_t i = startIndex_; i < endIndex_ && i < storage_->emails_.size(); ++i) {
-        jsonEmails.push_back(storage_->emails_[i].toJson());
+    for (Email& email : *this) {
+        jsonEmails.push_back(email.toJson());
     }
 
     return jsonEmails;
-}
\ No newline at end of file
+}
@@ -0,0 +1,332 @@
+#include "EmailSegmentFile.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "BinaryIO.hpp"
+#include "Email.hpp"
+#include "EmailListView.hpp"
+#include "Logger.hpp"
+
+using namespace BinaryIO;
+
+namespace {
+    constexpr char SEGMENT_MAGIC[16] = "InlookSegment/2"; // Version 2 stores stable blob hashes.
+
+    enum class BodyKind : uint8_t { None, Standard, Multipart };
+    enum class AttributeKind : uint8_t { Serialized, Blob };
+
+    struct SegmentHeader {
+        char magic[16];
+        uint64_t emailCount;
+        uint64_t indexOffset;
+        uint64_t headersOffset;
+        uint64_t bodiesOffset;
+        uint64_t attributesOffset;
+        uint64_t fileSize;
+    };
+
+    struct IndexEntry {
+        uint64_t uniqueHash;
+        uint64_t headerOffset;     // Relative to the headers section.
+        uint64_t bodyOffset;       // Relative to the bodies section.
+        uint64_t attributeOffset;  // Relative to the attributes section.
+        uint8_t isMIMEMultipart;
+        BodyKind bodyKind;
+        uint8_t padding[6];
+    };
+
+    // A section of a segment being written, streamed to a file of its own until the segment is assembled,
+    // so writing does not hold a copy of the corpus in memory.
+    struct SectionFile {
+        std::filesystem::path path;
+        std::ofstream out;
+
+        explicit SectionFile(std::filesystem::path sectionPath)
+            : path(std::move(sectionPath)), out(path, std::ios::binary | std::ios::trunc) {}
+
+        ~SectionFile() {
+            out.close();
+            std::error_code error;
+            std::filesystem::remove(path, error);
+        }
+
+        uint64_t size() {
+            return static_cast<uint64_t>(out.tellp());
+        }
+
+        bool appendTo(std::ostream& segment) {
+            uint64_t length = size();
+            out.close();
+            if (out.fail()) return false;
+            if (length == 0) return true; // Inserting an empty buffer would mark the segment failed.
+            std::ifstream in(path, std::ios::binary);
+            return static_cast<bool>(segment << in.rdbuf());
+        }
+    };
+
+    void writeBytes(std::ostream& out, std::string_view bytes) {
+        writeValue(out, static_cast<uint64_t>(bytes.size()));
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    // Bounds-checked reads straight out of the mapping. Any overrun marks the reader failed.
+    struct MappedReader {
+        const char* position;
+        const char* end;
+        bool failed = false;
+
+        template <typename T>
+        T value() {
+            T result{};
+            if (end - position < static_cast<std::ptrdiff_t>(sizeof(T))) {
+                failed = true;
+                return result;
+            }
+            std::memcpy(&result, position, sizeof(T));
+            position += sizeof(T);
+            return result;
+        }
+
+        std::string_view bytes(uint64_t length) {
+            if (static_cast<uint64_t>(end - position) < length) {
+                failed = true;
+                return {};
+            }
+            std::string_view result(position, length);
+            position += length;
+            return result;
+        }
+
+        std::string_view string() { return bytes(value<uint32_t>()); }
+        std::string_view longBytes() { return bytes(value<uint64_t>()); }
+    };
+
+    // Shared by both overloads of EmailSegmentFile::write, over any range of emails.
+    template <typename Emails>
+    std::optional<size_t> writeSegment(const std::filesystem::path& path, Emails& emailList) {
+        std::filesystem::path temporary = path;
+        temporary += ".tmp";
+        std::vector<IndexEntry> index;
+        SectionFile headerSection(temporary.string() + ".headers");
+        SectionFile bodySection(temporary.string() + ".bodies");
+        SectionFile attributeSection(temporary.string() + ".attributes");
+        std::ostream& headers = headerSection.out;
+        std::ostream& bodies = bodySection.out;
+        std::ostream& attributes = attributeSection.out;
+
+        for (const Email& email : emailList) {
+            IndexEntry entry{};
+            entry.uniqueHash = email.getUniqueHash();
+            entry.isMIMEMultipart = email.getIsMIMEMultipart();
+            entry.headerOffset = headers.tellp();
+            entry.bodyOffset = bodies.tellp();
+            entry.attributeOffset = attributes.tellp();
+
+            std::map<std::string, std::string> header = email.getHeader();
+            writeValue(headers, static_cast<uint32_t>(header.size()));
+            for (const auto& [key, value] : header) {
+                writeString(headers, key);
+                writeString(headers, value);
+            }
+
+            std::shared_ptr<EmailBody> body = email.getBody();
+            if (auto* standardBody = dynamic_cast<StandardEmailBody*>(body.get())) {
+                entry.bodyKind = BodyKind::Standard;
+                writeBytes(bodies, standardBody->getAllBodyData());
+            } else if (auto* multiPartBody = dynamic_cast<MIMEMultipartBodies*>(body.get())) {
+                entry.bodyKind = BodyKind::Multipart;
+                std::vector<MIMEMultipartPart> parts = multiPartBody->getMultipartParts();
+                writeValue(bodies, static_cast<uint32_t>(parts.size()));
+                for (const MIMEMultipartPart& part : parts) {
+                    auto partHeader = part.getHeader();
+                    writeValue(bodies, static_cast<uint32_t>(partHeader.size()));
+                    for (const auto& [key, values] : partHeader) {
+                        writeString(bodies, key);
+                        writeValue(bodies, static_cast<uint32_t>(values.size()));
+                        for (const std::string& value : values) {
+                            writeString(bodies, value);
+                        }
+                    }
+                    writeBytes(bodies, part.getBody());
+                }
+            } else {
+                entry.bodyKind = BodyKind::None;
+            }
+
+            std::vector<std::string> keys = email.getAttributeKeys();
+            writeValue(attributes, static_cast<uint32_t>(keys.size()));
+            for (const std::string& key : keys) {
+                writeString(attributes, key);
+                std::shared_ptr<AttributeBagValueInterface> value = email.getAttributeValue(key);
+                if (auto* blob = dynamic_cast<AttributeBagBlob*>(value.get())) {
+                    writeValue(attributes, AttributeKind::Blob);
+                    writeValue(attributes, static_cast<uint64_t>(blob->getBlob()->hash()));
+                    writeBytes(attributes, blob->getBlob()->view());
+                } else {
+                    writeValue(attributes, AttributeKind::Serialized);
+                    writeBytes(attributes, value->serializeToString());
+                }
+            }
+            index.push_back(entry);
+        }
+
+        if (!headers || !bodies || !attributes) {
+            LOG_ERROR << "Failed to write the sections of email segment " << temporary.string() << ".";
+            return std::nullopt;
+        }
+
+        SegmentHeader header{};
+        std::memcpy(header.magic, SEGMENT_MAGIC, sizeof(header.magic));
+        header.emailCount = index.size();
+        header.indexOffset = sizeof(SegmentHeader);
+        header.headersOffset = header.indexOffset + index.size() * sizeof(IndexEntry);
+        header.bodiesOffset = header.headersOffset + headerSection.size();
+        header.attributesOffset = header.bodiesOffset + bodySection.size();
+        header.fileSize = header.attributesOffset + attributeSection.size();
+
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            writeValue(out, header);
+            out.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(index.size() * sizeof(IndexEntry)));
+            if (!headerSection.appendTo(out) || !bodySection.appendTo(out) || !attributeSection.appendTo(out) || !out.flush()) {
+                LOG_ERROR << "Failed to write email segment " << temporary.string() << ".";
+                return std::nullopt;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+        if (error) {
+            LOG_ERROR << "Failed to replace email segment " << path.string() << ": " << error.message();
+            return std::nullopt;
+        }
+        return index.size();
+    }
+}
+
+std::optional<size_t> EmailSegmentFile::write(const std::filesystem::path& path, EmailListView& emailList) {
+    return writeSegment(path, emailList);
+}
+
+std::optional<size_t> EmailSegmentFile::write(const std::filesystem::path& path, const std::vector<Email>& emails) {
+    return writeSegment(path, emails);
+}
+
+std::optional<size_t> EmailSegmentFile::load(const std::filesystem::path& path, EmailListView& emailList) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG_ERROR << "Unable to open email segment " << path.string() << ".";
+        return std::nullopt;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SegmentHeader)) {
+        close(fd);
+        LOG_ERROR << "Email segment " << path.string() << " is too short.";
+        return std::nullopt;
+    }
+    void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        LOG_ERROR << "Unable to map email segment " << path.string() << ".";
+        return std::nullopt;
+    }
+    // Shared by every body and blob left in the mapping, which is unmapped once the last of them is gone.
+    size_t length = st.st_size;
+    std::shared_ptr<const void> owner(mapping, [length](const void* address) {
+        munmap(const_cast<void*>(address), length);
+    });
+    const char* base = static_cast<const char*>(mapping);
+
+    SegmentHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    // The count is bounded by the space left for the index before the section offsets are derived from it,
+    // so neither a damaged count nor an overflowing product gets past here.
+    if (std::memcmp(header.magic, SEGMENT_MAGIC, sizeof(header.magic)) != 0 || header.fileSize != length ||
+        header.indexOffset != sizeof(SegmentHeader) ||
+        header.emailCount > (length - header.indexOffset) / sizeof(IndexEntry) ||
+        header.headersOffset != header.indexOffset + header.emailCount * sizeof(IndexEntry) ||
+        header.attributesOffset > length || header.bodiesOffset > header.attributesOffset || header.headersOffset > header.bodiesOffset) {
+        LOG_ERROR << path.string() << " is not a complete email segment.";
+        return std::nullopt;
+    }
+    madvise(mapping, header.bodiesOffset, MADV_SEQUENTIAL); // Index and headers are read front to back.
+
+    // Parsed in full before anything is queued, so a damaged file inserts nothing.
+    std::vector<Email> emails;
+    emails.reserve(header.emailCount);
+    const char* sectionEnd[] = {base + header.bodiesOffset, base + header.attributesOffset, base + length};
+    for (uint64_t i = 0; i < header.emailCount; ++i) {
+        IndexEntry entry;
+        std::memcpy(&entry, base + header.indexOffset + i * sizeof(IndexEntry), sizeof(entry));
+        // Offsets are checked against their section before any pointer is formed from them.
+        if (entry.headerOffset > header.bodiesOffset - header.headersOffset ||
+            entry.bodyOffset > header.attributesOffset - header.bodiesOffset ||
+            entry.attributeOffset > length - header.attributesOffset) {
+            LOG_ERROR << "Email segment " << path.string() << " has a damaged index at email " << i << ".";
+            return std::nullopt;
+        }
+        MappedReader headers{base + header.headersOffset + entry.headerOffset, sectionEnd[0]};
+        MappedReader bodies{base + header.bodiesOffset + entry.bodyOffset, sectionEnd[1]};
+        MappedReader attributes{base + header.attributesOffset + entry.attributeOffset, sectionEnd[2]};
+
+        Email& email = emails.emplace_back();
+        email.setIsMIMEMultipart(entry.isMIMEMultipart);
+        for (uint32_t count = headers.value<uint32_t>(), h = 0; h < count && !headers.failed; ++h) {
+            std::string_view key = headers.string();
+            email.setHeader(std::string(key), std::string(headers.string()));
+        }
+
+        if (entry.bodyKind == BodyKind::Standard) {
+            email.setBody(std::make_unique<StandardEmailBody>(bodies.longBytes(), owner));
+        } else if (entry.bodyKind == BodyKind::Multipart) {
+            auto multiPartBody = std::make_unique<MIMEMultipartBodies>();
+            for (uint32_t parts = bodies.value<uint32_t>(), p = 0; p < parts && !bodies.failed; ++p) {
+                std::pmr::map<std::string, std::vector<std::string>> partHeader;
+                for (uint32_t count = bodies.value<uint32_t>(), h = 0; h < count && !bodies.failed; ++h) {
+                    std::vector<std::string>& values = partHeader[std::string(bodies.string())];
+                    for (uint32_t valueCount = bodies.value<uint32_t>(), v = 0; v < valueCount && !bodies.failed; ++v) {
+                        values.emplace_back(bodies.string());
+                    }
+                }
+                multiPartBody->addPart(partHeader, std::string(bodies.longBytes()));
+            }
+            email.setBody(std::move(multiPartBody));
+        }
+
+        for (uint32_t count = attributes.value<uint32_t>(), a = 0; a < count && !attributes.failed; ++a) {
+            std::string key(attributes.string());
+            if (attributes.value<AttributeKind>() == AttributeKind::Blob) {
+                uint64_t hash = attributes.value<uint64_t>();
+                std::string_view bytes = attributes.longBytes();
+                if (attributes.failed) break;
+                email.insertAttribute(key, std::make_unique<AttributeBagBlob>(BlobStore::getInstance()->internMapped(bytes, hash, owner)));
+            } else {
+                std::string serialized(attributes.longBytes());
+                if (attributes.failed) break;
+                std::unique_ptr<AttributeBagValueInterface> value;
+                try {
+                    value = AttributeBagRegistry::deserializeAttribute(serialized);
+                } catch (const std::exception& e) {
+                    LOG_ERROR << "Email segment " << path.string() << " has a damaged attribute at email " << i << ": " << e.what();
+                    return std::nullopt;
+                }
+                if (value) {
+                    email.insertAttribute(key, std::move(value));
+                }
+            }
+        }
+
+        if (headers.failed || bodies.failed || attributes.failed) {
+            LOG_ERROR << "Email segment " << path.string() << " is truncated at email " << i << ".";
+            return std::nullopt;
+        }
+        email.setUniqueHash(entry.uniqueHash);
+    }
+
+    for (Email& email : emails) {
+        emailList.insertEmail(std::move(email));
+    }
+    return header.emailCount;
+}
@@ -1,36 +1,236 @@
 #include "EmailStorage.hpp"
 #include "EmailListView.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <utility>
 
-bool EmailStorage::refresh_full_view_size_(size_t *s, size_t *e) {
-    s = 0;
-    *e = emails_.size();
-    return 1;
+// Each thread is handed a slot on first insert and keeps appending to the same shard afterwards.
+static size_t threadSlot() {
+    static std::atomic<size_t> nextSlot = 0;
+    thread_local size_t slot = nextSlot.fetch_add(1, std::memory_order_relaxed);
+    return slot;
+}
+
+void EmailStorage::Shard::append(Email&& email) {
+    // Publish the row's tombstone word before the row itself, so every visible row has one.
+    if ((emails_.size() >> 6) >= tombstones_.size()) {
+        tombstones_.emplace_back(0);
+    }
+    emails_.emplace_back(std::move(email));
+}
+
+size_t EmailStorage::Shard::countLive(size_t begin, size_t end) const {
+    if (begin >= end) return 0;
+    if (removedCount_.load(std::memory_order_relaxed) == 0) return end - begin;
+
+    size_t removed = 0;
+    for (size_t row = begin; row < end;) {
+        size_t offset = row & 63;
+        size_t span = std::min<size_t>(64 - offset, end - row);
+        uint64_t mask = (span == 64 ? ~uint64_t{0} : ((uint64_t{1} << span) - 1)) << offset;
+        removed += std::popcount(tombstones_[row >> 6].load(std::memory_order_relaxed) & mask);
+        row += span;
+    }
+    return (end - begin) - removed;
+}
+
+EmailStorage::EmailStorage(size_t numShards) {
+    shards_.reserve(std::max<size_t>(numShards, 1));
+    for (size_t i = 0; i < std::max<size_t>(numShards, 1); ++i) {
+        shards_.push_back(std::make_unique<Shard>());
+    }
+}
+
+// Called with the shard's append lock held, so its published size only grows in order.
+void EmailStorage::publish(Shard& shard) {
+    shard.publishedSize_.store(shard.emails_.size(), std::memory_order_release);
+    epoch_.fetch_add(1, std::memory_order_release);
+}
+
+EmailStorage::Shard& EmailStorage::shardForThisThread() {
+    return *shards_[threadSlot() % shards_.size()];
+}
+
+std::vector<EmailRowRange> EmailStorage::fullRanges() const {
+    std::vector<EmailRowRange> ranges;
+    ranges.reserve(shards_.size());
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        ranges.push_back({i, 0, shards_[i]->emails_.size()});
+    }
+    return ranges;
+}
+
+void EmailStorage::insertEmail(Email&& email) {
+    std::shared_lock lock(storageMutex_);
+    Shard& shard = shardForThisThread();
+    {
+        std::lock_guard appendLock(shard.appendMutex_);
+        shard.append(std::move(email));
+        publish(shard);
+    }
+}
+
+EmailRowRange EmailStorage::insertEmails(std::vector<Email>&& emails) {
+    std::shared_lock lock(storageMutex_);
+    size_t shardIndex = threadSlot() % shards_.size();
+    Shard& shard = *shards_[shardIndex];
+    EmailRowRange inserted{shardIndex, 0, 0};
+    {
+        std::lock_guard appendLock(shard.appendMutex_);
+        inserted.begin = shard.emails_.size();
+        for (Email& email : emails) {
+            shard.append(std::move(email));
+        }
+        inserted.end = shard.emails_.size();
+        publish(shard);
+    }
+    emails.clear();
+    return inserted;
 }
 
 EmailListView EmailStorage::getFullView() {
     std::shared_lock lock(storageMutex_);
-    return EmailListView(this, 0, emails_.size());
+    return EmailListView(this, fullRanges(), true);
+}
+
+EmailStorageSnapshot EmailStorage::getSnapshot() {
+    // Announce the pin before checking for a running compaction, which checks in the opposite order.
+    for (;;) {
+        pinnedSnapshots_.fetch_add(1);
+        if (!compacting_.load()) break;
+        pinnedSnapshots_.fetch_sub(1);
+        compacting_.wait(true);
+    }
+    // Epoch first, so the sizes read after it cover at least the publications it counts.
+    EmailStorageGeneration generation{epoch_.load(std::memory_order_acquire), {}};
+    generation.shardSizes.reserve(shards_.size());
+    for (const auto& shard : shards_) {
+        generation.shardSizes.push_back(shard->publishedSize_.load(std::memory_order_acquire));
+    }
+    return EmailStorageSnapshot(this, std::move(generation));
 }
 
 std::vector<EmailListView> EmailStorage::split(int numParts) {
     std::shared_lock lock(storageMutex_);
-    return getFullView().split(numParts);
+    return EmailListView(this, fullRanges(), false).split(numParts); // Not getFullView(), which would re-lock.
 }
 
 void EmailStorage::commitPendingInserts() {
-    std::unique_lock lock(storageMutex_);
-    while (!pendingInserts_.empty()) {
-        emails_.push_back(pendingInserts_.front());
-        pendingInserts_.pop();
+    std::vector<Email> pending;
+    {
+        std::lock_guard lock(pendingMutex_);
+        if (pendingInserts_.empty()) return;
+        pending = std::move(pendingInserts_);
+        pendingInserts_.clear();
     }
+    insertEmails(std::move(pending));
 }
 
 nlohmann::json EmailStorage::getSimpleEmailJsonList() {
+    return getSnapshot().getSimpleEmailJsonList();
+}
+
+nlohmann::json EmailStorage::getEmailsByNumber(int start, int num_returned) {
+    return getSnapshot().getEmailsByNumber(start, num_returned);
+}
+
+void EmailStorage::removeEmail(const Email& email) {
+    removeWhere([&email](const Email& stored) { return stored == email; });
+}
+
+bool EmailStorage::removeRow(size_t shard, size_t row) {
     std::shared_lock lock(storageMutex_);
+    if (shard >= shards_.size() || row >= shards_[shard]->emails_.size()) {
+        return false;
+    }
+    return shards_[shard]->markRemoved(row);
+}
+
+size_t EmailStorage::compact() {
+    std::unique_lock lock(storageMutex_); // Rows move, so appenders and readers are held off.
+    compacting_.store(true);
+    if (openViews_.load() > 0 || pinnedSnapshots_.load() > 0) {
+        compacting_.store(false);
+        compacting_.notify_all();
+        LOG_DEBUG_VERBOSE << "Deferring compaction, " << openViews_.load() << " email views and "
+                          << pinnedSnapshots_.load() << " snapshots are still open.";
+        return 0;
+    }
+
+    size_t dropped = 0;
+    for (auto& shard : shards_) {
+        if (shard->removedCount_.load() == 0) continue;
+
+        size_t size = shard->emails_.size();
+        size_t kept = 0;
+        for (size_t row = 0; row < size; ++row) {
+            if (shard->isRemoved(row)) continue;
+            if (kept != row) shard->emails_[kept] = std::move(shard->emails_[row]);
+            ++kept;
+        }
+        shard->emails_.truncate(kept);
+        shard->publishedSize_.store(kept, std::memory_order_release);
+
+        shard->tombstones_.clear();
+        for (size_t word = 0; word < (kept + 63) / 64; ++word) {
+            shard->tombstones_.emplace_back(0);
+        }
+        dropped += size - kept;
+        shard->removedCount_ = 0;
+    }
+    if (dropped > 0) epoch_.fetch_add(1, std::memory_order_release);
+    compacting_.store(false);
+    compacting_.notify_all();
+    return dropped;
+}
+
+size_t EmailStorage::getRemovedCount() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        total += shard->removedCount_.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+int EmailStorage::getSize() {
+    return getSnapshot().getSize();
+}
+
+EmailStorageSnapshot::EmailStorageSnapshot(EmailStorage* storage, EmailStorageGeneration generation)
+    : storage_(storage),
+    generation_(std::move(generation)) {}
+
+EmailStorageSnapshot::EmailStorageSnapshot(EmailStorageSnapshot&& other) noexcept
+    : storage_(std::exchange(other.storage_, nullptr)),
+    generation_(std::move(other.generation_)) {}
+
+EmailStorageSnapshot::~EmailStorageSnapshot() {
+    if (storage_) storage_->pinnedSnapshots_.fetch_sub(1);
+}
+
+uint64_t EmailStorageSnapshot::getEpoch() const {
+    return generation_.epoch;
+}
+
+size_t EmailStorageSnapshot::getSize() const {
+    size_t total = 0;
+    for (size_t shard = 0; shard < generation_.shardSizes.size(); ++shard) {
+        total += storage_->shards_[shard]->countLive(0, generation_.shardSizes[shard]);
+    }
+    return total;
+}
+
+nlohmann::json EmailStorageSnapshot::getSimpleEmailJsonList() const {
     nlohmann::json jsonEmails = nlohmann::json::array();
     try {
-        for (auto& email : emails_) {
-            jsonEmails.push_back(email.toJson());
+        for (size_t shard = 0; shard < generation_.shardSizes.size(); ++shard) {
+            auto& stored = *storage_->shards_[shard];
+            for (size_t row = 0; row < generation_.shardSizes[shard]; ++row) {
+                if (!stored.isRemoved(row)) {
+                    jsonEmails.push_back(stored.emails_[row].toJson());
+                }
+            }
         }
     } catch (std::exception &e) {
         LOG_ERROR << "Issue";
@@ -38,23 +238,38 @@ nlohmann::json EmailStorage::getSimpleEmailJsonList() {
     return jsonEmails;
 }
 
-nlohmann::json EmailStorage::getEmailsByNumber(int start, int num_returned) {
-    std::shared_lock lock(storageMutex_);
+nlohmann::json EmailStorageSnapshot::getEmailsByNumber(int start, int num_returned) const {
     nlohmann::json jsonEmails = nlohmann::json::array();
 
-    if (start < 0 || start >= static_cast<int>(emails_.size())) {
+    if (start < 0 || num_returned <= 0) {
         return jsonEmails;
     }
 
-    int end = std::min(start + num_returned, static_cast<int>(emails_.size()));
-
+    // Positions count live emails across shards in shard order, the same order views iterate in.
+    size_t skip = start;
+    size_t remaining = num_returned;
     try {
-        for (int i = start; i < end; ++i) {
-            jsonEmails.push_back(emails_[i].toJson());
+        for (size_t shard = 0; shard < generation_.shardSizes.size() && remaining > 0; ++shard) {
+            auto& stored = *storage_->shards_[shard];
+            size_t shardSize = generation_.shardSizes[shard];
+            size_t shardLive = stored.countLive(0, shardSize);
+            if (skip >= shardLive) {
+                skip -= shardLive;
+                continue;
+            }
+            for (size_t row = 0; row < shardSize && remaining > 0; ++row) {
+                if (stored.isRemoved(row)) continue;
+                if (skip > 0) {
+                    --skip;
+                    continue;
+                }
+                jsonEmails.push_back(stored.emails_[row].toJson());
+                --remaining;
+            }
         }
     } catch (const std::exception &e) {
         LOG_ERROR << "Error fetching emails: " << e.what();
     }
 
     return jsonEmails;
-}
\ No newline at end of file
+}
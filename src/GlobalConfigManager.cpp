@@ -11,6 +11,10 @@ GlobalConfigManager* GlobalConfigManager::getInstance() {
     return &instance;
 }
 
+GlobalConfigManager::~GlobalConfigManager() {
+    if (rootThread_.joinable()) rootThread_.join();
+}
+
 bool GlobalConfigManager::isReady() const {
     return (rootPluginExecutor_.second && true);
 }
@@ -111,16 +115,35 @@ void GlobalConfigManager::executeRootAsync() {
         return;
     }
 
-    std::future<void> executionTask = std::async(std::launch::async, [this]() {
+    if (executing_.exchange(true)) {
+        LOG_WARNING << "Root plugin is already executing.";
+        return;
+    }
+
+    // A thread of its own rather than a pool task, which would hold a worker for the whole run. Waits on task
+    // groups from here still run queued tasks. Not std::async, whose discarded future blocked until the run finished.
+    if (rootThread_.joinable()) rootThread_.join(); // The previous run has finished, executing_ was clear.
+    rootThread_ = std::thread([this]() {
         LOG_INFO << "Executing root plugin asynchronously.";
-        EmailListView rootEmailList = emailStorage_->getFullView();
-        bool success = rootPluginExecutor_.second->execute(&rootEmailList);
-        rootEmailList.commitInserts();
+        bool success;
+        try {
+            EmailListView rootEmailList = emailStorage_->getFullView();
+            success = rootPluginExecutor_.second->execute(&rootEmailList);
+            rootEmailList.commitInserts();
+        } catch (const std::exception& e) {
+            LOG_ERROR << "Root plugin execution threw: " << e.what();
+            success = false;
+        }
         if (success) {
             LOG_INFO << "Root plugin execution completed successfully. ";
         } else {
             LOG_ERROR << "Root plugin execution failed.";
         }
+        // The root view is closed now, so emails removed during the run can be reclaimed.
+        if (emailStorage_->getRemovedCount() > 0) {
+            LOG_INFO << "Compacted " << emailStorage_->compact() << " removed emails from storage.";
+        }
+        executing_.store(false);
     });
 }
 
@@ -7,11 +7,14 @@
 #include "GlobalConfigManager.hpp"
 #include "PluginRegistry.hpp"
 #include "WebUIManager.hpp"
+#include "WorkStealingPool.hpp"
 
 
 int main(int argc, char* argv[]) {
     LOG_INFO << "Program started.";
     ArgumentParser::getInstance()->parse(argc, argv);
+    WorkStealingPool::configure(GlobalConfigManager::getInstance()->getGlobalConfigValue<size_t>("worker_threads", 0),
+                                GlobalConfigManager::getInstance()->getGlobalConfigValue<bool>("pin_worker_threads", false));
     Plugins->loadAllPlugins(); // Loads the CreateFunc and handle for all plugins as needed.
     GlobalConfigManager::getInstance()->initialize_root_plugin_instance(); // Initializes the root instance.
     Logger::getInstance()->startLogging(); // Logging on
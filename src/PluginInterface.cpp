@@ -49,6 +49,10 @@ std::string PluginInterface::getState() const {
     return stateManager_.getState();
 }
 
+void PluginInterface::setExecutionState(const std::string& state) {
+    SET_PLUGIN_STATE(state);
+}
+
 void PluginInterface::CustomErrorHandler::error(const nlohmann::json_pointer<std::string>& pointer,
                                                   const nlohmann::json& instance,
                                                   const std::string& message) {
@@ -0,0 +1,15 @@
+#include "PluginRunnableInterface.hpp"
+#include "EmailListView.hpp"
+
+bool PluginRunnableInterface::executeInBatches(EmailListView* emailList, size_t batchSize) {
+    std::vector<Email*> batch;
+    batch.reserve(batchSize);
+    for (Email& email : *emailList) {
+        batch.push_back(&email);
+        if (batch.size() == batchSize) {
+            if (!executeBatch(batch)) return false;
+            batch.clear();
+        }
+    }
+    return batch.empty() || executeBatch(batch);
+}
@@ -10,11 +10,13 @@ PluginStateManager::PluginStateManager(bool addDefaultTransitions) : currentStat
         addTransition("LOADED", "READY");
         addTransition("READY", "RUNNING");
         addTransition("RUNNING", "COMPLETE");
+        addTransition("COMPLETE", "RUNNING"); // Plugins are run again on every chunk, and on every workflow run.
     }
 }
 
 // Allows adding additional custom transitions.
 void PluginStateManager::addTransition(const std::string &from, const std::string &to) {
+    std::lock_guard lock(mtx_);
     states.insert({from, to});         // Ensure states are tracked.
     transitions[from].insert("FAILED"); // Force transitions to FAILED from state.
     transitions[to].insert("FAILED");
@@ -23,11 +25,13 @@ void PluginStateManager::addTransition(const std::string &from, const std::strin
 
 // Returns all states tracked in the state manager
 std::set<std::string> PluginStateManager::getStates() const {
+    std::lock_guard lock(mtx_);
     return states;
 }
 
 // Gets viable transitions from the current state.
 std::set<std::string> PluginStateManager::getTransitions() const {
+    std::lock_guard lock(mtx_);
     auto it = transitions.find(currentState);
     if (it != transitions.end()) {
         return it->second;
@@ -37,6 +41,7 @@ std::set<std::string> PluginStateManager::getTransitions() const {
 
 // Gets viable transitions from a given state.
 std::set<std::string> PluginStateManager::getTransitions(const std::string& state) const {
+    std::lock_guard lock(mtx_);
     auto it = transitions.find(state);
     if (it != transitions.end()) {
         return it->second;
@@ -46,6 +51,7 @@ std::set<std::string> PluginStateManager::getTransitions(const std::string& stat
 
 // Removes a transition between two states.
 bool PluginStateManager::removeTransition(const std::string &from, const std::string &to) {
+    std::lock_guard lock(mtx_);
     auto fromIt = transitions.find(from);
     if (fromIt == transitions.end()) {
         return false;
@@ -74,6 +80,7 @@ bool PluginStateManager::removeTransition(const std::string &from, const std::st
 
 // Transition function that checks if a transition is allowed
 bool PluginStateManager::transitionTo(const std::string& newState, const std::string& callerName, int line) {
+    std::lock_guard lock(mtx_);
     if (currentState == newState) {
         return true;
     }
@@ -93,5 +100,6 @@ bool PluginStateManager::transitionTo(const std::string& newState, const std::st
 
 // Returns the current state.
 std::string PluginStateManager::getState() const {
+    std::lock_guard lock(mtx_);
     return currentState;
 }
\ No newline at end of file
@@ -0,0 +1,269 @@
+#include "ResultCache.hpp"
+#include <algorithm>
+#include "AttributeBagValueInterface.hpp"
+#include "BinaryIO.hpp"
+#include "Email.hpp"
+#include "EmailListView.hpp"
+#include "GlobalConfigManager.hpp"
+#include "Logger.hpp"
+#include "PluginExecutorInterface.hpp"
+#include "StableHash.hpp"
+
+using namespace BinaryIO;
+using namespace StableHash; // Keys are persisted, so they must not change between builds.
+
+namespace {
+    // Reads one entry at the stream's position. Entries are [key][count] then count (name, value) pairs.
+    bool readEntry(std::istream& in, uint64_t& key, ResultCache::Attributes& attributes) {
+        uint32_t count;
+        if (!readValue(in, key) || !readValue(in, count)) return false;
+        attributes.resize(count);
+        for (auto& [name, value] : attributes) {
+            if (!readString(in, name) || !readString(in, value)) return false;
+        }
+        return true;
+    }
+}
+
+ResultCache* ResultCache::getInstance() {
+    static ResultCache instance(GlobalConfigManager::getInstance()->getGlobalConfigValue<std::string>("result_cache_dir", "cache"),
+                                GlobalConfigManager::getInstance()->getGlobalConfigValue<uint64_t>("result_cache_max_mb", 0) << 20);
+    return &instance;
+}
+
+ResultCache::ResultCache(const std::filesystem::path& directory, uint64_t maxBytes)
+    : logPath_(directory / "results.log"),
+    maxBytes_(maxBytes) {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        LOG_ERROR << "Unable to create result cache directory " << directory << ": " << error.message();
+    }
+
+    std::unordered_map<uint64_t, uint64_t> entrySizes; // Key to the size of its newest entry.
+    {
+        std::ifstream in(logPath_, std::ios::binary);
+        uint64_t key;
+        Attributes attributes;
+        uint64_t offset = 0;
+        while (in && readEntry(in, key, attributes)) {
+            index_[key] = offset;
+            uint64_t next = static_cast<uint64_t>(in.tellg());
+            entrySizes[key] = next - offset;
+            offset = next;
+        }
+        logSize_ = offset;
+    }
+    // Drop a half-written entry left by a crash, so new entries start on a boundary.
+    if (std::filesystem::exists(logPath_) && std::filesystem::file_size(logPath_) != logSize_) {
+        LOG_WARNING << "Discarding a partial entry at the end of " << logPath_ << ".";
+        std::filesystem::resize_file(logPath_, logSize_);
+    }
+    uint64_t liveBytes = 0;
+    for (const auto& [key, size] : entrySizes) {
+        liveBytes += size;
+    }
+    if (liveBytes * 2 < logSize_ || (maxBytes_ > 0 && logSize_ > maxBytes_)) {
+        compact(entrySizes);
+    }
+
+    writer_.open(logPath_, std::ios::binary | std::ios::app);
+    reader_.open(logPath_, std::ios::binary);
+    if (!writer_ || !reader_) {
+        LOG_ERROR << "Unable to open result cache " << logPath_ << ", results will not be cached.";
+    }
+    LOG_DEBUG_VERBOSE << "Result cache " << logPath_ << " opened with " << index_.size() << " entries.";
+}
+
+void ResultCache::compact(const std::unordered_map<uint64_t, uint64_t>& entrySizes) {
+    // Newest first, so the oldest entries are the ones left out when over the cap.
+    std::vector<std::pair<uint64_t, uint64_t>> entries(index_.begin(), index_.end()); // (key, offset)
+    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    uint64_t liveBytes = 0;
+    for (const auto& [key, size] : entrySizes) {
+        liveBytes += size;
+    }
+    // Over the cap, the log is trimmed to half of it, so it does not fill up again after a few more results.
+    uint64_t budget = (maxBytes_ > 0 && liveBytes > maxBytes_) ? maxBytes_ / 2 : liveBytes;
+    uint64_t keptBytes = 0;
+    size_t kept = 0;
+    while (kept < entries.size() && keptBytes + entrySizes.at(entries[kept].first) <= budget) {
+        keptBytes += entrySizes.at(entries[kept].first);
+        ++kept;
+    }
+    entries.resize(kept);
+    std::reverse(entries.begin(), entries.end());
+
+    std::filesystem::path compactedPath = logPath_;
+    compactedPath += ".compact";
+    std::unordered_map<uint64_t, uint64_t> compactedIndex;
+    uint64_t offset = 0;
+    {
+        std::ifstream in(logPath_, std::ios::binary);
+        std::ofstream out(compactedPath, std::ios::binary | std::ios::trunc);
+        uint64_t key;
+        Attributes attributes;
+        for (const auto& [entryKey, entryOffset] : entries) {
+            in.seekg(static_cast<std::streamoff>(entryOffset));
+            if (!readEntry(in, key, attributes)) break;
+            writeValue(out, key);
+            writeValue(out, static_cast<uint32_t>(attributes.size()));
+            for (const auto& [name, value] : attributes) {
+                writeString(out, name);
+                writeString(out, value);
+            }
+            compactedIndex[key] = offset;
+            offset += entrySizes.at(key);
+        }
+        if (!out.flush()) {
+            LOG_WARNING << "Unable to compact " << logPath_ << ", keeping it as it is.";
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(compactedPath, logPath_, error);
+    if (error) {
+        LOG_WARNING << "Unable to replace " << logPath_ << " with its compacted copy: " << error.message();
+        return;
+    }
+    LOG_DEBUG_VERBOSE << "Compacted " << logPath_ << " from " << logSize_ << " to " << offset << " bytes, "
+                      << index_.size() - compactedIndex.size() << " entries dropped.";
+    index_ = std::move(compactedIndex);
+    logSize_ = offset;
+}
+
+uint64_t ResultCache::makeKey(PluginInterface& plugin, const Email& email) {
+    uint64_t hash = fnv1a(FNV_OFFSET, plugin.getPluginName());
+    hash = fnv1a(hash, plugin.getConfig().dump()); // Object keys are sorted, so the dump is canonical.
+    hash = fnv1a(hash, static_cast<uint64_t>(email.getUniqueHash()));
+
+    std::vector<std::string> present = email.getAttributeKeys();
+    for (const std::string& input : plugin.getInputAttributes()) {
+        hash = fnv1a(hash, input);
+        if (std::find(present.begin(), present.end(), input) == present.end()) {
+            hash = fnv1a(hash, uint64_t{0});
+            continue;
+        }
+        std::shared_ptr<AttributeBagValueInterface> value = email.getAttributeValue(input);
+        if (auto* blob = dynamic_cast<AttributeBagBlob*>(value.get())) { // Hash the bytes in place, never copy them out.
+            hash = fnv1a(hash, blob->getBlob()->view());
+        } else {
+            hash = fnv1a(hash, value->serializeToString());
+        }
+    }
+    return hash;
+}
+
+bool ResultCache::lookup(uint64_t key, Attributes& attributes) {
+    std::lock_guard lock(mtx_);
+    auto it = index_.find(key);
+    if (it == index_.end() || !reader_.is_open()) return false;
+    if (unflushed_) {
+        writer_.flush();
+        unflushed_ = false;
+    }
+    reader_.clear();
+    reader_.seekg(static_cast<std::streamoff>(it->second));
+    uint64_t storedKey;
+    return readEntry(reader_, storedKey, attributes) && storedKey == key;
+}
+
+void ResultCache::store(uint64_t key, const Attributes& attributes) {
+    std::lock_guard lock(mtx_);
+    if (!writer_.is_open() || full_) return;
+    if (maxBytes_ > 0 && logSize_ >= maxBytes_) {
+        LOG_WARNING << "Result cache " << logPath_ << " reached its size cap, new results are not cached until it is reopened.";
+        full_ = true;
+        return;
+    }
+    uint64_t offset = logSize_;
+    writeValue(writer_, key);
+    writeValue(writer_, static_cast<uint32_t>(attributes.size()));
+    logSize_ += sizeof(key) + sizeof(uint32_t);
+    for (const auto& [name, value] : attributes) {
+        writeString(writer_, name);
+        writeString(writer_, value);
+        logSize_ += 2 * sizeof(uint32_t) + name.size() + value.size();
+    }
+    index_[key] = offset;
+    unflushed_ = true;
+}
+
+void ResultCache::flush() {
+    std::lock_guard lock(mtx_);
+    writer_.flush();
+    unflushed_ = false;
+}
+
+size_t ResultCache::getEntryCount() const {
+    std::lock_guard lock(mtx_);
+    return index_.size();
+}
+
+std::vector<std::string> ResultCache::getCachedAttributes(PluginInterface& plugin) {
+    if (dynamic_cast<PluginExecutorInterface*>(&plugin)) return {}; // Results of executors are their children's.
+    std::vector<std::string> inputs = plugin.getInputAttributes();
+    std::vector<std::string> generated;
+    for (const std::string& output : plugin.getOutputAttributes()) {
+        if (std::find(inputs.begin(), inputs.end(), output) == inputs.end()) {
+            generated.push_back(output);
+        }
+    }
+    return generated;
+}
+
+bool ResultCache::executeCached(PluginInterface& plugin, EmailListView* emailList) {
+    std::vector<std::string> generated = getCachedAttributes(plugin);
+    if (generated.empty()) {
+        return plugin.execute(emailList);
+    }
+
+    // Apply every hit in place, and collect the misses (with their keys, taken before the plugin changes them).
+    EmailRowSelection misses;
+    std::unordered_map<uint64_t, uint64_t> missKeys; // (shard, row) to key.
+    auto rowId = [](size_t shard, size_t row) { return (static_cast<uint64_t>(shard) << 48) | row; };
+    size_t hits = 0;
+    Attributes attributes;
+    for (auto it = emailList->begin(); it != emailList->end(); ++it) {
+        uint64_t key = makeKey(plugin, *it);
+        if (lookup(key, attributes)) {
+            for (const auto& [name, value] : attributes) {
+                it->insertAttribute(name, AttributeBagRegistry::deserializeAttribute(value));
+            }
+            ++hits;
+            continue;
+        }
+        EmailListView::appendRow(misses, it.shard(), it.row());
+        missKeys[rowId(it.shard(), it.row())] = key;
+    }
+    LOG_DEBUG_VERBOSE << "Result cache for " << plugin.getInstanceID() << ": " << hits << " hits, " << missKeys.size() << " misses.";
+    if (missKeys.empty()) {
+        // The plugin never runs, so its state is reported for it.
+        plugin.setExecutionState("RUNNING");
+        plugin.setExecutionState("COMPLETE");
+        return true;
+    }
+
+    EmailListView missView = emailList->select(std::move(misses));
+    size_t missRows = missView.getRowCount();
+    bool status = plugin.execute(&missView);
+    missView.commitInserts();
+
+    if (status) {
+        for (auto it = missView.begin(); it != missView.end(); ++it) {
+            auto key = missKeys.find(rowId(it.shard(), it.row()));
+            if (key == missKeys.end()) continue; // Inserted by the plugin.
+            std::vector<std::string> present = it->getAttributeKeys();
+            Attributes results;
+            for (const std::string& name : generated) {
+                if (std::find(present.begin(), present.end(), name) != present.end()) {
+                    results.emplace_back(name, it->getAttributeValue(name)->serializeToString());
+                }
+            }
+            store(key->second, results);
+        }
+        flush();
+    }
+    emailList->absorbSlice(missView, missRows);
+    return status;
+}
@@ -0,0 +1,195 @@
+#include "WorkStealingPool.hpp"
+#include <algorithm>
+#include <utility>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "Logger.hpp"
+
+WorkStealingPool* WorkStealingPool::getInstance() {
+    static WorkStealingPool instance = [] {
+        std::lock_guard lock(configMutex_);
+        started_ = true;
+        return WorkStealingPool(configuredWorkers_ > 0 ? configuredWorkers_ : std::thread::hardware_concurrency(),
+                                configuredPinning_);
+    }();
+    return &instance;
+}
+
+bool WorkStealingPool::configure(size_t numWorkers, bool pinWorkers) {
+    std::lock_guard lock(configMutex_);
+    if (started_) {
+        LOG_WARNING << "Worker pool already started, ignoring its new configuration.";
+        return false;
+    }
+    configuredWorkers_ = numWorkers;
+    configuredPinning_ = pinWorkers;
+    return true;
+}
+
+WorkStealingPool::WorkStealingPool(size_t numWorkers, bool pinWorkers) {
+    numWorkers = std::max<size_t>(numWorkers, 1);
+    workers_.reserve(numWorkers);
+    for (size_t i = 0; i < numWorkers; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    threads_.reserve(numWorkers);
+    for (size_t i = 0; i < numWorkers; ++i) {
+        threads_.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+
+    if (pinWorkers) {
+#ifdef __linux__
+        size_t cores = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t i = 0; i < threads_.size(); ++i) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(i % cores, &cpus);
+            if (pthread_setaffinity_np(threads_[i].native_handle(), sizeof(cpus), &cpus) != 0) {
+                LOG_WARNING << "Unable to pin worker thread " << i << " to core " << i % cores << ".";
+            }
+        }
+#else
+        LOG_WARNING << "Pinning worker threads is only supported on Linux.";
+#endif
+    }
+    LOG_DEBUG_VERBOSE << "Started " << threads_.size() << " worker threads" << (pinWorkers ? ", pinned to cores." : ".");
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard lock(sleepMutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::submit(std::function<void()> task) {
+    size_t target = (currentPool_ == this) ? currentWorker_ : nextQueue_.fetch_add(1) % workers_.size();
+    {
+        std::lock_guard lock(workers_[target]->mtx);
+        workers_[target]->tasks.push_back(std::move(task));
+    }
+    queued_.fetch_add(1);
+    {
+        std::lock_guard lock(sleepMutex_); // Pairs with the predicate check, so the wake-up cannot be missed.
+    }
+    wake_.notify_one();
+}
+
+size_t WorkStealingPool::getWorkerCount() const {
+    return workers_.size();
+}
+
+bool WorkStealingPool::isWorkerThread() const {
+    return currentPool_ == this;
+}
+
+void WorkStealingPool::runTask(std::function<void()>& task) {
+    try {
+        task();
+    } catch (const std::exception& e) {
+        LOG_ERROR << "Uncaught exception in pool task: " << e.what();
+    }
+}
+
+bool WorkStealingPool::tryPop(size_t self, std::function<void()>& task) {
+    {
+        Worker& own = *workers_[self];
+        std::lock_guard lock(own.mtx);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < workers_.size(); ++i) {
+        Worker& victim = *workers_[(self + i) % workers_.size()];
+        std::lock_guard lock(victim.mtx);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::workerLoop(size_t index) {
+    currentPool_ = this;
+    currentWorker_ = index;
+    for (;;) {
+        std::function<void()> task;
+        if (tryPop(index, task)) {
+            queued_.fetch_sub(1);
+            runTask(task);
+            continue;
+        }
+        std::unique_lock lock(sleepMutex_);
+        wake_.wait(lock, [this] { return stopping_ || queued_.load() > 0; });
+        if (stopping_ && queued_.load() == 0) return;
+    }
+}
+
+bool TaskGroup::State::runNext(std::unique_lock<std::mutex>& lock) {
+    if (queue.empty()) return false;
+    std::function<void()> task = std::move(queue.front());
+    queue.pop_front();
+    lock.unlock();
+    std::exception_ptr taskError;
+    try {
+        task();
+    } catch (...) {
+        taskError = std::current_exception();
+    }
+    completed.fetch_add(1);
+    lock.lock();
+    if (taskError && !error) error = taskError;
+    if (--pending == 0) changed.notify_all();
+    return true;
+}
+
+TaskGroup::TaskGroup(WorkStealingPool& pool) : pool_(pool) {}
+
+TaskGroup::~TaskGroup() {
+    try {
+        wait();
+    } catch (...) {
+        // Discarded, only wait() reports task exceptions.
+    }
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    {
+        std::lock_guard lock(state_->mtx);
+        state_->queue.push_back(std::move(task));
+        ++state_->pending;
+    }
+    state_->changed.notify_all(); // A waiting thread picks it up if no worker gets there first.
+    // One ticket per task. A ticket finding the queue empty means the waiting thread ran its task already.
+    pool_.submit([state = state_] {
+        std::unique_lock lock(state->mtx);
+        state->runNext(lock);
+    });
+}
+
+void TaskGroup::wait() {
+    std::unique_lock lock(state_->mtx);
+    while (state_->pending > 0) {
+        if (!state_->runNext(lock)) {
+            // The rest are running elsewhere. Woken when one finishes last or a nested task is queued.
+            state_->changed.wait(lock, [this] { return state_->pending == 0 || !state_->queue.empty(); });
+        }
+    }
+    if (state_->error) {
+        std::rethrow_exception(std::exchange(state_->error, nullptr));
+    }
+}
+
+size_t TaskGroup::getCompletedCount() const {
+    return state_->completed.load();
+}